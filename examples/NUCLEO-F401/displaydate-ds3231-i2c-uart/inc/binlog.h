@@ -0,0 +1,71 @@
+/**
+ * @file binlog.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief Deferred Binary Logging for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details the BINLOG macro and public function declarations for
+ * sending log statements as a format string ID plus raw arguments over a
+ * USART, as part of the stm32f4xx-amperture-periphlib package.
+ *
+ * Format strings are placed in a non-loaded ELF section, so they cost no
+ * flash and are never formatted on the target. tools/binlog_decode.py reads
+ * them back out of the ELF and rebuilds the text on the host.
+ *
+ * Record layout on the wire, little-endian:
+ *   [0xC0 | nargs] [id lo] [id hi] [arg0 x4] ... [argN x4]
+ *
+ * Arguments are sent as 32-bit words, so the format may use any of the
+ * integer conversions (%u %d %x %X %c, with width) but not %s or floats.
+ */
+#ifndef AMP_BINLOG_H
+#define AMP_BINLOG_H
+
+// Defines
+
+#define BINLOG_MAX_ARGS 8
+#define BINLOG_HEADER   ((uint8_t)0xC0)
+
+// Format strings go to a section without the "a" flag, so the linker gives it
+// no load address and objcopy leaves it out of the image. The trailing '@'
+// comments out the flags GCC appends; this is ARM GAS syntax.
+#define BINLOG_SECTION __attribute__((section(".binlog,\"\",%progbits @"), used))
+
+// Counts 0 to 8 variadic arguments.
+#define _BINLOG_NARGS(...) _BINLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, \
+        2, 1, 0)
+#define _BINLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+/** BINLOG
+ * @brief Logs a format string ID and up to 8 integer arguments.
+ * @param USARTx: Which USART peripheral to log on.
+ * @param fmt: String literal, printf style, integer conversions only.
+ *
+ * The ID is the low 16 bits of the string's address. The section has no
+ * load address, so the linker places it at 0 and the ID is simply the
+ * offset inside .binlog; should a linker script give it a real address,
+ * the decoder still subtracts the section base modulo 64 KiB. Either way
+ * .binlog is limited to 64 KiB of format strings.
+ */
+#define BINLOG(USARTx, fmt, ...) do { \
+        static const char _binlogFmt[] BINLOG_SECTION = fmt; \
+        binlogWrite((USARTx), (uint16_t)(uint32_t)_binlogFmt, \
+                _BINLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+    } while(0)
+
+// Public Functions
+
+/** Binlog Write
+ * @brief Packs one log record and queues it on the USART in a single write.
+ * @param *USARTx: Which USART peripheral to send over.
+ * @param id: Format string ID, normally supplied by BINLOG.
+ * @param nargs: Number of 32-bit arguments that follow, at most 8.
+ *
+ * Goes through usartWrite, so it inherits the port's ring buffer or
+ * blocking behaviour. Use BINLOG rather than calling this directly.
+ */
+void binlogWrite(USART_TypeDef* USARTx, uint16_t id, uint8_t nargs, ...);
+
+#endif /* AMP_BINLOG_H */
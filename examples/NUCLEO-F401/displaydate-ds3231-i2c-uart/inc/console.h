@@ -0,0 +1,117 @@
+/**
+ * @file console.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief Command Console for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details public function declarations for a non-blocking,
+ * table-driven command console on top of the USART driver, as part of the
+ * stm32f4xx-amperture-periphlib package.
+ *
+ * The console is fed received bytes as they arrive, either from
+ * consolePoll in the main loop or consoleFeed from any Rx path. It echoes
+ * and edits the current line and, on Enter, splits it into arguments and
+ * calls the matching command. Nothing waits on a keystroke.
+ */
+#ifndef AMP_CONSOLE_H
+#define AMP_CONSOLE_H
+
+// Defines
+
+// Longest line the editor accepts, terminator included.
+#ifndef CONSOLE_LINE_SIZE
+#define CONSOLE_LINE_SIZE 64
+#endif
+
+// Most arguments passed to a command, the command name included.
+#ifndef CONSOLE_MAX_ARGS
+#define CONSOLE_MAX_ARGS 8
+#endif
+
+// Typedefs
+
+/** Console Handler
+ * @brief Runs one command.
+ * @param *USARTx: Console port, for output.
+ * @param argc: Number of arguments, argv[0] is the command name.
+ * @param *argv[]: Null terminated arguments.
+ * @retval 1 for success, 0 to have the console print the usage line.
+ */
+typedef uint8_t (*consoleHandler)(USART_TypeDef* USARTx, uint8_t argc,
+        char* argv[]);
+
+/** Console Command
+ * @brief One entry in a console's command table.
+ */
+typedef struct consoleCommand {
+    const char*     name;
+    const char*     usage;      // Argument summary, shown by help.
+    const char*     help;       // One line description, shown by help.
+    uint8_t         minArgs;    // Not counting the command name.
+    uint8_t         maxArgs;
+    consoleHandler  handler;
+} consoleCommand;
+
+/** Console
+ * @brief Console state, one per port.
+ */
+typedef struct console {
+    USART_TypeDef*          USARTx;
+    const consoleCommand*   commands;
+    uint8_t                 count;
+    const char*             prompt;
+    uint8_t                 len;
+    uint8_t                 lastCr;     // Swallow the LF of a CR LF pair.
+    char                    line[CONSOLE_LINE_SIZE];
+} console;
+
+// Public Functions
+
+/** Console Init
+ * @brief Sets up a console and prints its first prompt.
+ * @param *con: Console state.
+ * @param *USARTx: Port to echo and print on, already initialised.
+ * @param *commands: Command table. "help" is built in unless overridden.
+ * @param count: Number of entries in commands.
+ * @param *prompt: Prompt string, may be 0.
+ * @retval void
+ */
+void consoleInit(console* con, USART_TypeDef* USARTx,
+        const consoleCommand* commands, uint8_t count, const char* prompt);
+
+
+/** Console Feed
+ * @brief Runs received bytes through the line editor.
+ * @param *con: Console state.
+ * @param *data: Received bytes.
+ * @param len: Number of bytes.
+ * @retval len.
+ *
+ * Commands run from here, so call it from thread context.
+ */
+uint16_t consoleFeed(console* con, const uint8_t* data, uint16_t len);
+
+
+/** Console Poll
+ * @brief Takes whatever the port has received and feeds it, without waiting.
+ * @param *con: Console state.
+ * @retval Number of bytes processed.
+ *
+ * Reads through usartRead, so start usartDmaRxEnable on the port with no
+ * callback first: input then collects in the DMA buffer while a command
+ * runs. Without it only the character in DR survives between polls.
+ */
+uint16_t consolePoll(console* con);
+
+
+/** Console Arg To Uint
+ * @brief Parses a decimal, or 0x-prefixed hex, argument.
+ * @param *arg: Argument string.
+ * @param *value: Parsed value.
+ * @retval 1 for success, 0 if arg is not a number or overflows 32 bits.
+ */
+uint8_t consoleArgToUint(const char* arg, uint32_t* value);
+
+#endif /* AMP_CONSOLE_H */
@@ -14,17 +14,6 @@
 #ifndef AMP_I2C_H
 #define AMP_I2C_H
 
-// Public Functions
-void i2cInit(I2C_TypeDef* , GPIO_TypeDef* , uint8_t, uint8_t, uint8_t);
-void i2cSendStop(I2C_TypeDef*);
-void i2cSendStart(I2C_TypeDef*);
-void i2cSendAddr7bit(I2C_TypeDef*, uint8_t, uint8_t);
-void i2cSendData(I2C_TypeDef*, uint8_t);
-uint8_t i2cRecvData(I2C_TypeDef*);
-uint8_t i2cStateCheck(I2C_TypeDef*, uint16_t, uint16_t);
-void i2cActivateAck(I2C_TypeDef*);
-void i2cDeactivateAck(I2C_TypeDef*);
-
 // Defines
 
 //BUSY, MSL, SB
@@ -55,4 +44,573 @@ void i2cDeactivateAck(I2C_TypeDef*);
 #define I2C_STATE_MASTER_BYTE_TRANSMITTED_SR1 ((uint16_t)0x0084)
 #define I2C_STATE_MASTER_BYTE_TRANSMITTED_SR2 ((uint16_t)0x0007)
 
+// OR into a device address to make it 10-bit, e.g. (I2C_ADDR_10BIT | 0x2A5).
+// Accepted by i2cTransaction.addr, i2cMemRead/Write and i2cSlaveEnable.
+#define I2C_ADDR_10BIT ((uint16_t)0x8000)
+
+// Bytes in the bitmap filled by i2cScan, one bit per 7-bit address.
+#define I2C_SCAN_MAP_SIZE 16
+
+// Whether i2cScan found a device at a 7-bit address.
+#define I2C_SCAN_FOUND(map, addr) (((map)[(addr) >> 3] >> ((addr) & 0x07)) & 1)
+
+// Per-address limit for i2cScan. A probe takes about 100us at 100kHz, so
+// only a hung bus ever gets near this.
+#ifndef AMP_I2C_SCAN_TIMEOUT_US
+#define AMP_I2C_SCAN_TIMEOUT_US 1000
+#endif
+
+// i2cTransaction.flags
+#define I2C_TXN_PEC         ((uint8_t)0x01) // SMBus PEC on the last byte.
+#define I2C_TXN_BLOCK_READ  ((uint8_t)0x02) // First byte read is the count.
+
+// SMBus 2.0 block transfers carry 1-32 bytes.
+#define AMP_I2C_SMBUS_BLOCK_MAX 32
+
+// Bound on one SMBus transaction. Stretching past 25ms is caught by the
+// hardware TIMEOUT flag; devices must have let go by 35ms.
+#ifndef AMP_I2C_SMBUS_TIMEOUT_US
+#define AMP_I2C_SMBUS_TIMEOUT_US 35000
+#endif
+
+// Bus speed applied by i2cInit, change later with i2cSpeedSet. Anything up
+// to 100kHz runs in standard mode, above that in fast mode up to 400kHz.
+#ifndef AMP_I2C_SPEED
+#define AMP_I2C_SPEED 100000
+#endif
+
+// Default bound on one blocking step (START, address, byte) and on
+// i2cTransfer. A 7 byte read takes under 1ms at 100kHz.
+#ifndef AMP_I2C_TIMEOUT_US
+#define AMP_I2C_TIMEOUT_US 10000
+#endif
+
+// Largest payload i2cMemWrite takes; it is staged on the stack behind the
+// register byte.
+#ifndef AMP_I2C_MEM_WRITE_MAX
+#define AMP_I2C_MEM_WRITE_MAX 32
+#endif
+
+// Shortest transfer phase worth handing to DMA once i2cDmaEnable is on.
+// Below this the per-byte interrupts are cheaper than setting up a stream.
+#ifndef AMP_I2C_DMA_MIN_LEN
+#define AMP_I2C_DMA_MIN_LEN 4
+#endif
+
+// Typedefs
+
+/** I2C Status
+ * @brief Outcome of a queued transaction.
+ */
+typedef enum i2cStatus {
+    I2C_OK = 0,
+    I2C_PENDING,            // Queued, or on the bus now.
+    I2C_ERR_PARAM,          // Bad pointer or unsupported peripheral.
+    I2C_ERR_NACK,           // AF: address or data byte not acknowledged.
+    I2C_ERR_ARLO,           // Arbitration lost to another master.
+    I2C_ERR_BERR,           // Misplaced START or STOP seen on the bus.
+    I2C_ERR_OVR,            // Overrun or underrun.
+    I2C_ERR_DMA,            // DMA transfer error.
+    I2C_ERR_TIMEOUT,        // No progress in time, bus has been recovered.
+    I2C_ERR_BUS_STUCK,      // A line is still held low after recovery.
+    I2C_ERR_PEC,            // SMBus PEC mismatch on a read.
+    I2C_ERR_SIZE            // SMBus block count was 0 or too big.
+} i2cStatus;
+
+struct i2cTransaction;
+
+/** I2C Callback
+ * @brief Called from interrupt context when a transaction finishes.
+ * @param *I2Cx: Which I2C peripheral ran the transaction.
+ * @param *txn: The finished transaction, status already set.
+ */
+typedef void (*i2cCallback)(I2C_TypeDef* I2Cx, struct i2cTransaction* txn);
+
+/** I2C Slave Callback
+ * @brief Called from interrupt context after a master wrote registers.
+ * @param *I2Cx: Which I2C peripheral was written to.
+ * @param reg: First register written.
+ * @param len: Number of registers written.
+ */
+typedef void (*i2cSlaveCallback)(I2C_TypeDef* I2Cx, uint8_t reg,
+        uint16_t len);
+
+/** I2C SMBus Alert Callback
+ * @brief Called from interrupt context when a device pulls SMBA low.
+ * @param *I2Cx: Which I2C peripheral saw the alert.
+ *
+ * Follow up with i2cSmbusAlertResponse outside the interrupt to find out
+ * which device it was.
+ */
+typedef void (*i2cSmbusAlertCallback)(I2C_TypeDef* I2Cx);
+
+/** I2C Transaction
+ * @brief One write, read, or write then repeated-start read.
+ *
+ * Owned by the driver from i2cSubmit until status leaves I2C_PENDING, so it
+ * and its buffers must stay valid until then. Several devices can share a
+ * bus by queueing their own transactions; priority decides who goes next.
+ */
+typedef struct i2cTransaction {
+    uint16_t                addr;       // 7-bit, or I2C_ADDR_10BIT | 10-bit.
+    const uint8_t*          txBuf;
+    uint16_t                txLen;      // Bytes written first, may be 0.
+    uint8_t*                rxBuf;
+    uint16_t                rxLen;      // Bytes read after, may be 0.
+    uint8_t                 priority;   // Larger runs sooner, 0 lowest.
+    uint8_t                 flags;      // I2C_TXN_*, usually 0.
+    i2cCallback             callback;   // May be 0.
+    volatile i2cStatus      status;
+    struct i2cTransaction*  next;       // Queue link, used by the driver.
+} i2cTransaction;
+
+// Public Functions
+
+/** I2C Init
+ * @brief Init function for i2c peripheral.
+ * @param *I2Cx: Which I2C internal peripheral to use.
+ * @param *GPIOx: Which GPIO Port to use.
+ * @param sclPin: GPIO pin to use for SCL, send as integer, NOT Bitmask.
+ * @param sdaPin: GPIO pin to use for SDA, send as integer, NOT Bitmask.
+ * @param afMode: Alternate Function mode for GPIO pins, refer to datasheet.
+ * @retval 1 for success, 0 if AMP_I2C_SPEED is out of reach of PCLK1; the
+ *         peripheral is then left disabled.
+ * @see http://www.st.com/st-web-ui/static/active/en/resource/technical/document/datasheet/DM00102166.pdf
+ */
+uint8_t i2cInit(I2C_TypeDef* I2Cx, 
+        GPIO_TypeDef* GPIOx, 
+        uint8_t sclPin, 
+        uint8_t sdaPin, 
+        uint8_t afMode
+);
+
+
+/** I2C Speed Set
+ * @brief Reprograms FREQ, CCR, DUTY and TRISE from the live PCLK1.
+ * @param *I2Cx: Which I2C peripheral to retune.
+ * @param speed: Requested SCL frequency in Hz, 1 to 400000.
+ * @param *achieved: Optional, receives the SCL frequency actually set.
+ * @retval 1 for success, 0 if out of reach or transactions are queued.
+ *
+ * CCR is rounded so the bus never runs faster than requested. Fast mode
+ * picks whichever of the 2:1 and 16:9 duty cycles lands closer, keeping
+ * the 1.3us minimum low time. PCLK1 must be at least 2MHz for standard
+ * mode and 4MHz for fast mode. The achieved value ignores rise time, which
+ * stretches the real period slightly on a heavily loaded bus.
+ */
+uint8_t i2cSpeedSet(I2C_TypeDef* I2Cx, uint32_t speed, uint32_t* achieved);
+
+
+/** I2C Speed Get
+ * @brief Reads back the SCL frequency produced by CCR and PCLK1.
+ * @param *I2Cx: Which I2C peripheral to check.
+ * @retval SCL frequency in Hz.
+ */
+uint32_t i2cSpeedGet(I2C_TypeDef* I2Cx);
+
+
+/** I2C Send Start
+ * @brief Sends the Start Bit on the I2C Peripheral.
+ * @param *I2Cx: Which peripheral to send the Start bit over.
+ */
+void i2cSendStart(I2C_TypeDef* I2Cx);
+
+
+/** I2C Send Stop
+ * @brief Sends the Stop Bit on the I2C Peripheral.
+ * @param *I2Cx: Which peripheral to send the Stop bit over.
+ */
+void i2cSendStop(I2C_TypeDef* I2Cx);
+
+
+/** I2C Send 7 Bit Address
+ * @brief Sends the 7 Bit Address call over the I2C peripheral.
+ * @param *I2Cx: Which peripheral to send the address over.
+ * @param addr: 7 Bit Address
+ * @param dir: 0 = Write, 1 = Read
+ */
+void i2cSendAddr7bit(I2C_TypeDef* I2Cx, 
+        uint8_t addr, 
+        uint8_t dir
+);
+
+
+/** I2C Send 10 Bit Address Header
+ * @brief Sends the 11110xx header that starts a 10 Bit Address.
+ * @param *I2Cx: Which peripheral to send the header over.
+ * @param addr: 10 Bit Address
+ * @param dir: 0 = Write, 1 = Read
+ *
+ * Write: START, header (dir 0), wait I2C_STATE_MASTER_MODE_ADDRESS10,
+ * i2cSendAddr10bitLow, wait I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE.
+ * Read: do the write sequence first, then repeated START, header (dir 1)
+ * alone, wait I2C_STATE_MASTER_RECEIVER_MODE_ACTIVE.
+ */
+void i2cSendAddr10bitHeader(I2C_TypeDef* I2Cx, uint16_t addr, uint8_t dir);
+
+
+/** I2C Send 10 Bit Address Low Byte
+ * @brief Sends address bits 7:0 once the header has been acknowledged.
+ * @param *I2Cx: Which peripheral to send the address over.
+ * @param addr: 10 Bit Address
+ */
+void i2cSendAddr10bitLow(I2C_TypeDef* I2Cx, uint16_t addr);
+
+
+/** I2C Send Byte
+ * @brief Sends an 8 bit data value over the I2C peripheral.
+ * @param *I2Cx: Which peripheral to send the data through.
+ * @param data: byte to send
+ * @retval void
+ */
+void i2cSendData(I2C_TypeDef* I2Cx, 
+        uint8_t addr
+);
+
+
+/** I2C Receive Byte
+ * @brief Retreives the data on the I2C peripheral.
+ * @param *I2Cx: Which peripheral to receive data from.
+ * @retval Byte pulled from I2C Data Register
+ */
+uint8_t i2cRecvData(I2C_TypeDef* I2Cx);
+
+
+/** I2C State Check
+ * @brief Check the state of both status registers on the I2C Peripheral.
+ * @param *I2Cx: Where x can be 1, 2, or 3.
+ * @param i2cStateSR1: Status Register 1 state desired.
+ * @param i2cStateSR2: Status Register 2 state desired.
+ * @retval Will return 1 for success, 0 for failure.
+ * 
+ * TODO: Don't like the fact that StdPeriph uses single variable for 
+ * I2C_CheckEvent(), but that allows them to use preprocessor macros for 
+ * states, giving better readability. Think about this one and look for a 
+ * desired solution.
+ */
+uint8_t i2cStateCheck(I2C_TypeDef* I2Cx, 
+        uint16_t i2cStateSR1, 
+        uint16_t i2cStateSR2
+);
+
+
+/** I2C Activate ACK
+ * @brief Activates the ACK feature of the given I2C Peripheral
+ * @param *I2Cx: Which peripheral to send the ACK bit over.
+ * @retval Byte pulled from I2C Data Register
+ */
+void i2cActivateAck(I2C_TypeDef* I2Cx);
+
+
+/** I2C Deactivate ACK
+ * @brief Activates the ACK feature of the given I2C Peripheral
+ * @param *I2Cx: Which peripheral to send the ACK bit over.
+ * @retval Byte pulled from I2C Data Register
+ */
+void i2cDeactivateAck(I2C_TypeDef* I2Cx);
+
+
+/** I2C Submit
+ * @brief Queues a transaction for the interrupt-driven engine.
+ * @param *I2Cx: Which I2C peripheral to run it on.
+ * @param *txn: Transaction to run. Its status is I2C_PENDING on return.
+ * @retval 1 if queued, 0 on bad parameters.
+ *
+ * Transactions run back to back, entirely from the event and error
+ * interrupts: the next START is issued in the same interrupt as the
+ * previous STOP, and the CPU only sees one short interrupt per byte.
+ *
+ * The queue is ordered by priority, first come first served within a
+ * priority. A transaction on the bus is never cut short, so a high
+ * priority IMU read waits at most for the current transaction (e.g. one
+ * EEPROM page write), not for everything queued before it. May be called
+ * from a callback to chain the next transfer. Don't mix with the blocking
+ * i2cSend and i2cRecv functions while anything is queued.
+ */
+uint8_t i2cSubmit(I2C_TypeDef* I2Cx, i2cTransaction* txn);
+
+
+/** I2C Idle
+ * @brief Checks whether the transaction queue has drained.
+ * @param *I2Cx: Which I2C peripheral to check.
+ * @retval 1 if nothing is queued or running, 0 otherwise.
+ */
+uint8_t i2cIdle(I2C_TypeDef* I2Cx);
+
+
+/** I2C Transfer
+ * @brief Queues a transaction and waits for it, for a bounded time.
+ * @param *I2Cx: Which I2C peripheral to use.
+ * @param *txn: Transaction to run, as for i2cSubmit.
+ * @param timeoutUs: Time allowed, including waiting behind others.
+ * @retval Final status of the transaction.
+ *
+ * If the transaction was on the bus when time ran out, i2cBusRecover runs
+ * and the result is I2C_ERR_TIMEOUT or I2C_ERR_BUS_STUCK.
+ */
+i2cStatus i2cTransfer(I2C_TypeDef* I2Cx, i2cTransaction* txn,
+        uint32_t timeoutUs);
+
+
+/** I2C Memory Read
+ * @brief Reads consecutive registers: register write, repeated START, read.
+ * @param *I2Cx: Which I2C peripheral to use.
+ * @param dev: Device address, 7-bit or I2C_ADDR_10BIT | 10-bit.
+ * @param reg: First register to read.
+ * @param *buf: Receives len bytes.
+ * @param len: Number of registers to read, at least 1.
+ * @retval I2C_OK or the error, as for i2cTransfer.
+ *
+ * Runs on the transaction engine, which follows the RM0368 receive
+ * sequences for 1, 2 and more bytes, so the device never sees an extra
+ * read. Bounded by AMP_I2C_TIMEOUT_US.
+ */
+i2cStatus i2cMemRead(I2C_TypeDef* I2Cx, uint16_t dev, uint8_t reg,
+        uint8_t* buf, uint16_t len);
+
+
+/** I2C Memory Write
+ * @brief Writes consecutive registers in a single transfer.
+ * @param *I2Cx: Which I2C peripheral to use.
+ * @param dev: Device address, 7-bit or I2C_ADDR_10BIT | 10-bit.
+ * @param reg: First register to write.
+ * @param *buf: Data for the registers.
+ * @param len: Number of registers, up to AMP_I2C_MEM_WRITE_MAX.
+ * @retval I2C_OK or the error, as for i2cTransfer.
+ */
+i2cStatus i2cMemWrite(I2C_TypeDef* I2Cx, uint16_t dev, uint8_t reg,
+        const uint8_t* buf, uint16_t len);
+
+
+/** I2C Scan
+ * @brief Finds which 7-bit addresses answer on the bus.
+ * @param *I2Cx: Which I2C peripheral to scan.
+ * @param *map: I2C_SCAN_MAP_SIZE bytes, bit (addr & 7) of map[addr >> 3] is
+ *        set for each device found. Test with I2C_SCAN_FOUND.
+ * @param *ids: Optional, 128 bytes indexed by address. Receives one byte
+ *        read from idReg of each device found, others are left untouched.
+ * @param idReg: Register to read into ids.
+ * @retval I2C_OK, or I2C_ERR_BUS_STUCK if the scan had to give up.
+ *
+ * Probes 0x08-0x77 with address-only writes on the transaction engine,
+ * each bounded by AMP_I2C_SCAN_TIMEOUT_US, so an empty bus takes about
+ * 12ms at 100kHz and a missing module never hangs it. A wedged bus is
+ * recovered on the way as for i2cTransfer.
+ */
+i2cStatus i2cScan(I2C_TypeDef* I2Cx, uint8_t* map, uint8_t* ids,
+        uint8_t idReg);
+
+
+/** I2C SMBus Enable
+ * @brief Switches the peripheral to SMBus host mode.
+ * @param *I2Cx: Which I2C peripheral, after i2cInit.
+ * @param pec: 1 to append and check PEC on the i2cSmbus* transfers.
+ * @param *alertGPIO: Port of the SMBA pin, 0 if not wired.
+ * @param alertPin: SMBA pin, as an integer.
+ * @param alert: Called when SMBA is pulled low, may be 0.
+ * @retval 1 for success, 0 on bad parameters or a busy queue.
+ *
+ * PEC is computed and checked by the peripheral (ENPEC), so it costs no
+ * CPU time. Clock stretching past the SMBus limits (25ms low, 10ms
+ * cumulative) ends the transfer with I2C_ERR_TIMEOUT. SMBus transfers run
+ * on interrupts only, DMA is not used while this is on.
+ */
+uint8_t i2cSmbusEnable(I2C_TypeDef* I2Cx, uint8_t pec,
+        GPIO_TypeDef* alertGPIO, uint8_t alertPin,
+        i2cSmbusAlertCallback alert);
+
+
+/** I2C SMBus Disable
+ * @brief Returns the peripheral to plain I2C.
+ * @param *I2Cx: Which I2C peripheral.
+ * @retval void
+ */
+void i2cSmbusDisable(I2C_TypeDef* I2Cx);
+
+
+/** I2C SMBus Read Word
+ * @brief SMBus Read Word: command, repeated START, 16-bit little endian.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param addr: 7-bit device address.
+ * @param cmd: Command code.
+ * @param *value: Receives the word.
+ * @retval I2C_OK or the error, I2C_ERR_PEC on a PEC mismatch.
+ */
+i2cStatus i2cSmbusReadWord(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t* value);
+
+
+/** I2C SMBus Write Word
+ * @brief SMBus Write Word: command, then 16-bit little endian.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param addr: 7-bit device address.
+ * @param cmd: Command code.
+ * @param value: Word to write.
+ * @retval I2C_OK or the error.
+ */
+i2cStatus i2cSmbusWriteWord(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t value);
+
+
+/** I2C SMBus Process Call
+ * @brief Writes a word and reads one back in a single transaction.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param addr: 7-bit device address.
+ * @param cmd: Command code.
+ * @param value: Word to send.
+ * @param *result: Receives the device's reply.
+ * @retval I2C_OK or the error, I2C_ERR_PEC on a PEC mismatch.
+ */
+i2cStatus i2cSmbusProcessCall(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t value, uint16_t* result);
+
+
+/** I2C SMBus Block Write
+ * @brief Command, byte count, then 1 to AMP_I2C_SMBUS_BLOCK_MAX bytes.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param addr: 7-bit device address.
+ * @param cmd: Command code.
+ * @param *data: Bytes to send.
+ * @param len: Number of bytes.
+ * @retval I2C_OK or the error.
+ */
+i2cStatus i2cSmbusBlockWrite(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        const uint8_t* data, uint8_t len);
+
+
+/** I2C SMBus Block Read
+ * @brief Command, repeated START, then as many bytes as the device says.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param addr: 7-bit device address.
+ * @param cmd: Command code.
+ * @param *data: AMP_I2C_SMBUS_BLOCK_MAX bytes of room.
+ * @param *len: Receives the number of bytes read.
+ * @retval I2C_OK, I2C_ERR_SIZE if the count was 0 or over 32 (data holds
+ *         what was read), or another error.
+ *
+ * The NACK for the last byte is set as soon as the count arrives, so
+ * short blocks depend on the event interrupt being serviced within a byte
+ * time (RM0368 27.3.3, method 2).
+ */
+i2cStatus i2cSmbusBlockRead(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint8_t* data, uint8_t* len);
+
+
+/** I2C SMBus Alert Response
+ * @brief Reads the Alert Response Address to find who pulled SMBA.
+ * @param *I2Cx: Which I2C peripheral.
+ * @param *addr: Receives the 7-bit address of the alerting device.
+ * @retval I2C_OK, or I2C_ERR_NACK if no device is alerting any more.
+ */
+i2cStatus i2cSmbusAlertResponse(I2C_TypeDef* I2Cx, uint8_t* addr);
+
+
+/** I2C Event Wait
+ * @brief Bounded replacement for spinning on i2cStateCheck.
+ * @param *I2Cx: Which I2C peripheral to check.
+ * @param stateSR1: SR1 bits to wait for, 0 for don't care.
+ * @param stateSR2: SR2 bits to wait for, 0 for don't care.
+ * @param timeoutUs: How long to wait.
+ * @retval I2C_OK, the error flag seen, or the result of a timeout.
+ *
+ * AF and BERR are answered with a STOP, ARLO needs none. On a timeout
+ * i2cBusRecover runs before returning I2C_ERR_TIMEOUT (or
+ * I2C_ERR_BUS_STUCK if that did not free the bus).
+ */
+i2cStatus i2cEventWait(I2C_TypeDef* I2Cx, uint16_t stateSR1,
+        uint16_t stateSR2, uint32_t timeoutUs);
+
+
+/** I2C Bus Recover
+ * @brief Frees a bus held by a slave that lost track of a transfer.
+ * @param *I2Cx: Which I2C peripheral, as set up by i2cInit.
+ * @retval I2C_OK, I2C_ERR_BUS_STUCK if a line stays low, or I2C_ERR_PARAM.
+ *
+ * Fails any transaction on the bus, clocks 9 SCL pulses and a STOP on the
+ * pins as GPIO, then applies I2C_CR1_SWRST and restores the configuration.
+ * Queued transactions restart afterwards. Takes about 100us.
+ */
+i2cStatus i2cBusRecover(I2C_TypeDef* I2Cx);
+
+
+/** I2C Slave Enable
+ * @brief Exposes a block of memory to an external master as registers.
+ * @param *I2Cx: Which I2C peripheral, after i2cInit.
+ * @param addr: Address to answer to, 7-bit or I2C_ADDR_10BIT | 10-bit.
+ * @param *regs: Register map, up to 256 bytes.
+ * @param size: Number of registers in the map.
+ * @param callback: Called after each write into the map, may be 0.
+ * @retval 1 for success, 0 on bad parameters or a busy master queue.
+ *
+ * Works like a typical sensor: the first byte of a write sets the register
+ * pointer and the rest are stored from there; a read (usually after a
+ * repeated START) returns registers from the pointer on, 0xFF past the
+ * end. On I2C1 and I2C3 reads run by DMA, so a whole status snapshot goes
+ * out in one burst with SCL stretched only while ADDR is serviced. Update
+ * the map with interrupts masked if a burst must never be torn. The master
+ * functions keep working on the same peripheral between slave transfers.
+ */
+uint8_t i2cSlaveEnable(I2C_TypeDef* I2Cx, uint16_t addr, uint8_t* regs,
+        uint16_t size, i2cSlaveCallback callback);
+
+
+/** I2C Slave Disable
+ * @brief Stops answering to the slave address.
+ * @param *I2Cx: Which I2C peripheral.
+ * @retval void
+ */
+void i2cSlaveDisable(I2C_TypeDef* I2Cx);
+
+
+/** I2C DMA Enable
+ * @brief Lets the transaction engine move bulk data by DMA.
+ * @param *I2Cx: I2C1 or I2C3, I2C2 has no free DMA streams.
+ * @retval 1 for success, 0 if unsupported or transactions are queued.
+ *
+ * Write and read phases of AMP_I2C_DMA_MIN_LEN bytes or more then run with
+ * DMAEN, and reads use LAST so the hardware NACKs the final byte. The CPU
+ * sees one interrupt per phase instead of one per byte. I2C1 uses DMA1
+ * Streams 7 (Tx) and 0 (Rx), I2C3 uses Streams 4 and 2.
+ */
+uint8_t i2cDmaEnable(I2C_TypeDef* I2Cx);
+
+
+/** I2C DMA Disable
+ * @brief Returns later transactions to per-byte interrupts.
+ * @param *I2Cx: Which I2C peripheral.
+ * @retval void
+ */
+void i2cDmaDisable(I2C_TypeDef* I2Cx);
+
+
+/** I2C DMA Rx IRQ Handler
+ * @brief Finishes a DMA read: STOP, then the next transaction.
+ * @param *I2Cx: Which I2C peripheral the stream serves.
+ * @retval void
+ *
+ * Installed on DMA1_Stream0_IRQHandler (I2C1) and DMA1_Stream2_IRQHandler
+ * (I2C3) by this library.
+ */
+void i2cDmaRxIRQHandler(I2C_TypeDef* I2Cx);
+
+
+/** I2C Event IRQ Handler
+ * @brief Runs the transaction state machine on SB/ADDR/BTF/TXE/RXNE.
+ * @param *I2Cx: Which I2C peripheral raised the interrupt.
+ * @retval void
+ *
+ * Installed on I2C1_EV_IRQHandler, I2C2_EV_IRQHandler and
+ * I2C3_EV_IRQHandler by this library.
+ */
+void i2cEvIRQHandler(I2C_TypeDef* I2Cx);
+
+
+/** I2C Error IRQ Handler
+ * @brief Ends the running transaction on AF, ARLO, BERR or OVR.
+ * @param *I2Cx: Which I2C peripheral raised the interrupt.
+ * @retval void
+ */
+void i2cErIRQHandler(I2C_TypeDef* I2Cx);
+
+
 #endif /* AMP_I2C_H */
@@ -21,4 +21,21 @@ typedef struct ds3231Date {
     uint8_t second;
     uint8_t year;
 } ds3231Date;
+
+/** DS3231 Read Date
+ * @brief Reads the seven time registers and converts them from BCD.
+ * @param *I2Cx: Which I2C peripheral the DS3231 is on.
+ * @param *date: Receives the date.
+ * @retval I2C_OK, or the error that cut the transfer short.
+ */
+i2cStatus ds3231_readDate(I2C_TypeDef* I2Cx, ds3231Date* date);
+
+/** DS3231 Write Date
+ * @brief Converts a date to BCD in place and writes the time registers.
+ * @param *I2Cx: Which I2C peripheral the DS3231 is on.
+ * @param *date: Date to write, left in BCD afterwards.
+ * @retval I2C_OK, or the error that cut the transfer short.
+ */
+i2cStatus ds3231_writeDate(I2C_TypeDef* I2Cx, ds3231Date* date);
+
 #endif //_AMP_DS3231_H
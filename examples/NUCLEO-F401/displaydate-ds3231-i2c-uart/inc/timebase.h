@@ -0,0 +1,65 @@
+/**
+ * @file timebase.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief Timebase Library for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details public function declarations for the cycle-accurate
+ * timebase used by the peripheral drivers for timeouts and statistics, as
+ * part of the stm32f4xx-amperture-periphlib package. It runs off the DWT
+ * cycle counter, so it needs no timer and no interrupt.
+ */
+#ifndef AMP_TIMEBASE_H
+#define AMP_TIMEBASE_H
+
+// Defines
+
+// Pass as a timeout to wait without limit.
+#define TIMEBASE_WAIT_FOREVER ((uint32_t)0xFFFFFFFF)
+
+// Public Functions
+
+/** Timebase Init
+ * @brief Starts the DWT cycle counter and latches the current HCLK.
+ *
+ * Called on first use automatically. Call again after changing the clock
+ * tree so microsecond conversions stay correct.
+ */
+void timebaseInit(void);
+
+
+/** Timebase Cycles Get
+ * @brief Reads the free-running CPU cycle counter.
+ * @retval Current cycle count, wraps every 2^32 cycles (~51 s at 84 MHz).
+ */
+uint32_t timebaseCyclesGet(void);
+
+
+/** Timebase Expired
+ * @brief Checks whether a timeout measured from a start stamp has run out.
+ * @param start: Value of timebaseCyclesGet() when the wait began.
+ * @param timeoutUs: Timeout in microseconds, or TIMEBASE_WAIT_FOREVER.
+ * @retval 1 if expired, 0 otherwise.
+ *
+ * Timeouts must stay below one counter wrap.
+ */
+uint8_t timebaseExpired(uint32_t start, uint32_t timeoutUs);
+
+
+/** Timebase Cycles To Microseconds
+ * @brief Converts a cycle count delta to microseconds.
+ * @param cycles: Number of CPU cycles.
+ * @retval Microseconds, rounded down.
+ */
+uint32_t timebaseCyclesToUs(uint32_t cycles);
+
+
+/** Timebase Delay
+ * @brief Busy-waits for the given number of microseconds.
+ * @param us: Delay in microseconds.
+ */
+void timebaseDelayUs(uint32_t us);
+
+#endif /* AMP_TIMEBASE_H */
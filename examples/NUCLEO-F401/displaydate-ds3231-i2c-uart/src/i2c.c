@@ -7,8 +7,8 @@
  *
  * This file contains private and public functions for using the I2C peripheral
  * on an stm32f4xx microcontroller. Comes as part of the 
- * stm32f4xx-amperture-periphlib package. At current does not support 
- * interrupts or DMA.
+ * stm32f4xx-amperture-periphlib package. Besides the blocking primitives,
+ * an interrupt-driven engine runs queued transactions, see i2cSubmit.
  *
  * This driver package at current is not meant to be simply included without
  * review into a project. It is fully expected that the programmer will 
@@ -20,24 +20,767 @@
 
 
 #include <stm32f4xx.h>
+#include <stdint.h>
+#include <string.h>
+#include <timebase.h>
+#include <rcc.h>
 #include "i2c.h"
 
+// Private Defines
 
-/** I2C Init
- * @brief Init function for i2c peripheral.
- * @param *I2Cx: Which I2C internal peripheral to use.
- * @param *GPIOx: Which GPIO Port to use.
- * @param sclPin: GPIO pin to use for SCL, send as integer, NOT Bitmask.
- * @param sdaPin: GPIO pin to use for SDA, send as integer, NOT Bitmask.
- * @param afMode: Alternate Function mode for GPIO pins, refer to datasheet.
- * @see http://www.st.com/st-web-ui/static/active/en/resource/technical/document/datasheet/DM00102166.pdf
- */
-void i2cInit(I2C_TypeDef* I2Cx, GPIO_TypeDef* GPIOx, uint8_t sclPin,
+// Longest wait for the hardware to finish a STOP before CR1 may be written
+// again; a STOP takes about one SCL period.
+#define AMP_I2C_STOP_TIMEOUT_US 1000
+
+#define AMP_I2C_SR1_ERRORS      (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF \
+                                | I2C_SR1_OVR)
+
+// Half an SCL period while bit-banging recovery clocks, 100kHz.
+#define AMP_I2C_RECOVER_HALF_US 5
+
+// CR1 bits that are configuration rather than one-shot requests, kept
+// across a software reset.
+#define AMP_I2C_CR1_CONFIG      (I2C_CR1_SMBUS | I2C_CR1_SMBTYPE \
+                                | I2C_CR1_ENARP | I2C_CR1_ENPEC | I2C_CR1_ENGC \
+                                | I2C_CR1_NOSTRETCH | I2C_CR1_ACK \
+                                | I2C_CR1_ALERT)
+
+// SMBus-only SR1 flags, all rc_w0 like the bus errors.
+#define AMP_I2C_SR1_SMBUS       (I2C_SR1_PECERR | I2C_SR1_TIMEOUT \
+                                | I2C_SR1_SMBALERT)
+
+// SMBA is AF4 for every I2C on the F401 (PB5, PB12, PA9).
+#define AMP_I2C_SMBA_AF         4
+
+// SMBus Alert Response Address.
+#define AMP_I2C_SMBUS_ARA       0x0C
+
+// First byte of a 10-bit address: 11110, address bits 9:8, R/W.
+#define AMP_I2C_HEADER10(addr)  (0xF0 | (((addr) >> 7) & 0x06))
+
+// Sent when the master reads past the end of the slave register map.
+#define AMP_I2C_SLAVE_PAD       0xFF
+
+// OAR1 bit 14 must always be kept at 1 (RM0368 27.6.3).
+#define AMP_I2C_OAR1_BIT14      ((uint32_t)1 << 14)
+
+// Fast mode SCL low time minimum, in ns.
+#define AMP_I2C_FM_TLOW_MIN_NS  1300
+
+// Maximum SCL/SDA rise times per mode, in ns, for TRISE.
+#define AMP_I2C_SM_TRISE_NS     1000
+#define AMP_I2C_FM_TRISE_NS     300
+
+// DMA interrupt flag positions within LISR/HISR for streams 0-3 / 4-7.
+static const uint8_t _i2cDmaFlagShift[4] = { 0, 6, 16, 22 };
+
+// FEIF, DMEIF, TEIF, HTIF, TCIF
+#define AMP_I2C_DMA_FLAGS_ALL   ((uint32_t)0x3D)
+#define AMP_I2C_DMA_FLAG_TE     ((uint32_t)0x08)
+#define AMP_I2C_DMA_FLAG_TC     ((uint32_t)0x20)
+
+// Private Types
+
+// Constant description of one I2C instance, lives in flash.
+typedef struct i2cPortConfig {
+    I2C_TypeDef*        I2Cx;
+    IRQn_Type           evIrq;
+    IRQn_Type           erIrq;
+    uint32_t            rccEnBit;       // Bit in RCC APB1ENR.
+
+    DMA_Stream_TypeDef* txStream;       // 0 if the port has no DMA.
+    uint8_t             txStreamNum;
+    uint8_t             txChannel;
+
+    DMA_Stream_TypeDef* rxStream;
+    uint8_t             rxStreamNum;
+    uint8_t             rxChannel;
+    IRQn_Type           rxDmaIrq;
+} i2cPortConfig;
+
+// Which half of the running transaction is on the bus.
+typedef enum i2cPhase {
+    I2C_PHASE_TX = 0,
+    I2C_PHASE_RX
+} i2cPhase;
+
+// Where a transfer addressed to us as a slave has got to.
+typedef enum i2cSlaveState {
+    I2C_SLAVE_IDLE = 0,
+    I2C_SLAVE_RX_REG,           // Written to, next byte is the pointer.
+    I2C_SLAVE_RX_DATA,          // Written to, storing from the pointer on.
+    I2C_SLAVE_TX                // Read from the pointer on.
+} i2cSlaveState;
+
+// Run-time state of one I2C, lives in RAM.
+typedef struct i2cPort {
+    const i2cPortConfig*        cfg;
+    i2cTransaction* volatile    head;   // Running transaction, queue front.
+    i2cTransaction*             tail;
+    i2cPhase                    phase;
+    uint16_t                    index;  // Bytes moved in this phase.
+    uint16_t                    rxTotal;    // Bytes to read, with any PEC.
+    uint8_t                     rxPec;      // Last byte of rxTotal is PEC.
+    uint8_t                     rxBlock;    // First byte is an SMBus count.
+    uint8_t                     rxBadCount; // Count didn't fit, cut short.
+    uint8_t                     pecError;   // PECERR seen this transaction.
+
+    uint8_t                     dmaReady;   // Streams configured.
+    uint8_t                     dmaEnabled;
+    uint8_t                     dmaActive;  // This phase is running on DMA.
+    uint8_t                     addrSent;   // SB answered, our ADDR is due.
+
+    GPIO_TypeDef*               GPIOx;  // Pins from i2cInit, for recovery.
+    uint8_t                     sclPin;
+    uint8_t                     sdaPin;
+
+    uint8_t*                    slaveRegs;  // Register map, 0 if no slave.
+    uint16_t                    slaveSize;
+    i2cSlaveCallback            slaveCallback;
+    volatile i2cSlaveState      slaveState;
+    uint8_t                     slavePtr;   // Register pointer last written.
+    uint16_t                    slaveIndex; // Next register this transfer.
+
+    uint8_t                     smbus;      // SMBus host mode, PEC engine on.
+    uint8_t                     smbusPec;   // PEC on the i2cSmbus* calls.
+    i2cSmbusAlertCallback       smbusAlert;
+} i2cPort;
+
+// Private Variables
+
+// DMA1 mapping per RM0368 Table 27. USART2 already holds Streams 5 and 6,
+// and I2C2_TX can only use Stream 7, which I2C1_TX needs, so I2C2 runs
+// without DMA.
+static const i2cPortConfig _i2cPortConfigs[] = {
+    {
+        .I2Cx = I2C1, .evIrq = I2C1_EV_IRQn, .erIrq = I2C1_ER_IRQn,
+        .rccEnBit = RCC_APB1ENR_I2C1EN,
+        .txStream = DMA1_Stream7, .txStreamNum = 7, .txChannel = 1,
+        .rxStream = DMA1_Stream0, .rxStreamNum = 0, .rxChannel = 1,
+        .rxDmaIrq = DMA1_Stream0_IRQn,
+    },
+    {
+        .I2Cx = I2C2, .evIrq = I2C2_EV_IRQn, .erIrq = I2C2_ER_IRQn,
+        .rccEnBit = RCC_APB1ENR_I2C2EN,
+    },
+    {
+        .I2Cx = I2C3, .evIrq = I2C3_EV_IRQn, .erIrq = I2C3_ER_IRQn,
+        .rccEnBit = RCC_APB1ENR_I2C3EN,
+        .txStream = DMA1_Stream4, .txStreamNum = 4, .txChannel = 3,
+        .rxStream = DMA1_Stream2, .rxStreamNum = 2, .rxChannel = 3,
+        .rxDmaIrq = DMA1_Stream2_IRQn,
+    },
+};
+
+#define AMP_I2C_PORT_COUNT \
+    (sizeof(_i2cPortConfigs) / sizeof(_i2cPortConfigs[0]))
+
+static i2cPort _i2cPorts[AMP_I2C_PORT_COUNT];
+
+//// Private Functions
+
+static i2cPort* _i2cPortGet(I2C_TypeDef* I2Cx){
+    uint8_t i;
+    for(i = 0; i < AMP_I2C_PORT_COUNT; i++){
+        if(_i2cPortConfigs[i].I2Cx == I2Cx){
+            _i2cPorts[i].cfg = &_i2cPortConfigs[i];
+            return &_i2cPorts[i];
+        }
+    }
+    return 0;
+}
+
+static uint32_t _i2cCriticalEnter(void){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void _i2cCriticalExit(uint32_t primask){
+    __set_PRIMASK(primask);
+}
+
+// CR1 must not be written while a STOP is pending, or a second one may be
+// requested (RM0368 27.6.1).
+static void _i2cStopWait(I2C_TypeDef* I2Cx){
+    uint32_t start = timebaseCyclesGet();
+
+    while(I2Cx -> CR1 & I2C_CR1_STOP){
+        if(timebaseExpired(start, AMP_I2C_STOP_TIMEOUT_US)) break;
+    }
+}
+
+static void _i2cDmaFlagsClear(uint8_t streamNum, uint32_t flags){
+    flags <<= _i2cDmaFlagShift[streamNum & 0x03];
+    if(streamNum > 3) DMA1 -> HIFCR = flags;
+    else DMA1 -> LIFCR = flags;
+}
+
+static uint32_t _i2cDmaFlagsGet(uint8_t streamNum){
+    uint32_t isr = (streamNum > 3) ? DMA1 -> HISR : DMA1 -> LISR;
+    return (isr >> _i2cDmaFlagShift[streamNum & 0x03]) & AMP_I2C_DMA_FLAGS_ALL;
+}
+
+// Points a stream at a buffer and starts it. The stream's CR was set up by
+// i2cDmaEnable.
+static void _i2cDmaStart(i2cPort* port, DMA_Stream_TypeDef* stream,
+        uint8_t streamNum, uint8_t* buf, uint16_t len){
+    _i2cDmaFlagsClear(streamNum, AMP_I2C_DMA_FLAGS_ALL);
+    stream -> M0AR  =   (uint32_t)buf;
+    stream -> NDTR  =   len;
+    stream -> CR    |=  DMA_SxCR_EN;
+
+    port -> dmaActive = 1;
+    port -> cfg -> I2Cx -> CR2 |= I2C_CR2_DMAEN;
+}
+
+// Quietens the peripheral between transfers. Event and error interrupts
+// stay on while a slave register map is listening for its address.
+static void _i2cIrqIdle(i2cPort* port){
+    uint32_t mask = I2C_CR2_ITBUFEN;
+
+    if(port -> slaveRegs == 0){
+        mask |= I2C_CR2_ITEVTEN;
+        if(port -> smbusAlert == 0) mask |= I2C_CR2_ITERREN;
+    }
+    port -> cfg -> I2Cx -> CR2 &= ~mask;
+}
+
+static void _i2cDmaStop(i2cPort* port){
+    port -> cfg -> I2Cx -> CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST);
+    port -> cfg -> txStream -> CR &= ~(DMA_SxCR_EN);
+    port -> cfg -> rxStream -> CR &= ~(DMA_SxCR_EN);
+    port -> dmaActive = 0;
+}
+
+// Sets both streams up for this peripheral's DR, once.
+static void _i2cDmaConfigure(i2cPort* port){
+    const i2cPortConfig* cfg = port -> cfg;
+
+    if(port -> dmaReady) return;
+
+    RCC -> AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+    // Streams must be fully stopped before they can be reconfigured.
+    cfg -> txStream -> CR   &=  ~(DMA_SxCR_EN);
+    cfg -> rxStream -> CR   &=  ~(DMA_SxCR_EN);
+    while((cfg -> txStream -> CR | cfg -> rxStream -> CR) & DMA_SxCR_EN);
+
+    cfg -> txStream -> PAR  =   (uint32_t)&(cfg -> I2Cx -> DR);
+    cfg -> txStream -> CR   =   (0
+                        | ((uint32_t)cfg -> txChannel << 25) // Channel
+                        | DMA_SxCR_MINC     // Memory Increment
+                        | DMA_SxCR_DIR_0    // Memory to Peripheral
+                        );
+    cfg -> txStream -> FCR  =   0;          // Direct mode, no FIFO
+
+    cfg -> rxStream -> PAR  =   (uint32_t)&(cfg -> I2Cx -> DR);
+    cfg -> rxStream -> CR   =   (0
+                        | ((uint32_t)cfg -> rxChannel << 25) // Channel
+                        | DMA_SxCR_MINC     // Memory Increment
+                                            // DIR = 00, Peripheral to Memory
+                        | DMA_SxCR_TCIE     // Transfer Complete Int Enable
+                        | DMA_SxCR_TEIE     // Transfer Error Int Enable
+                        );
+    cfg -> rxStream -> FCR  =   0;
+
+    NVIC_EnableIRQ(cfg -> rxDmaIrq);
+    port -> dmaReady = 1;
+}
+
+// Whether this phase of the running transaction goes over DMA. Single byte
+// reads keep the interrupt sequence, LAST needs at least two.
+static uint8_t _i2cDmaUse(i2cPort* port, uint16_t len){
+    // With ENPEC set the DMA end of transfer also moves a PEC byte, so
+    // SMBus transfers stay on interrupts.
+    return port -> dmaEnabled && !(port -> smbus)
+        && (len >= AMP_I2C_DMA_MIN_LEN) && (len >= 2);
+}
+
+// SCL period in PCLK1 cycles per CCR unit for each mode.
+static uint32_t _i2cCcrCycles(uint32_t ccr){
+    if(!(ccr & I2C_CCR_FS)) return 2;
+    return (ccr & I2C_CCR_DUTY) ? 25 : 3;
+}
+
+// Smallest CCR that doesn't exceed speed, 0 if it won't fit the 12 bits or
+// is below the mode's minimum.
+static uint32_t _i2cCcrCompute(uint32_t pclk, uint32_t speed,
+        uint32_t cycles, uint32_t min){
+    uint32_t ccr = (pclk + (cycles * speed) - 1) / (cycles * speed);
+
+    if(ccr < min) ccr = min;
+    if(ccr > I2C_CCR_CCR) return 0;
+    return ccr;
+}
+
+// Fills CR2 FREQ, CCR and TRISE. The peripheral must be disabled.
+static uint8_t _i2cTimingConfigure(I2C_TypeDef* I2Cx, uint32_t speed,
+        uint32_t* achieved){
+    uint32_t pclk = rccPclk1Get();
+    uint32_t mhz = pclk / 1000000;
+    uint32_t ccr, ccr2, ccr169;
+    uint32_t hz2 = 0, hz169 = 0;
+
+    if((speed == 0) || (speed > 400000) || (mhz > 50)) return 0;
+    if(mhz < ((speed > 100000) ? 4 : 2)) return 0;
+
+    if(speed <= 100000){
+        // Standard mode: high = low = CCR. Minimum CCR is 4.
+        ccr = _i2cCcrCompute(pclk, speed, 2, 4);
+        if(ccr == 0) return 0;
+        I2Cx -> TRISE = (mhz * AMP_I2C_SM_TRISE_NS) / 1000 + 1;
+    } else {
+        // Fast mode: low = 2 * CCR (2:1) or 16 * CCR (16:9).
+        ccr2 = _i2cCcrCompute(pclk, speed, 3, 1);
+        if((ccr2 != 0) && ((uint64_t)2 * ccr2 * 1000000000
+                    >= (uint64_t)AMP_I2C_FM_TLOW_MIN_NS * pclk)){
+            hz2 = pclk / (3 * ccr2);
+        }
+        ccr169 = _i2cCcrCompute(pclk, speed, 25, 1);
+        if((ccr169 != 0) && ((uint64_t)16 * ccr169 * 1000000000
+                    >= (uint64_t)AMP_I2C_FM_TLOW_MIN_NS * pclk)){
+            hz169 = pclk / (25 * ccr169);
+        }
+        if((hz2 == 0) && (hz169 == 0)) return 0;
+
+        // Both round down from speed, so the larger is the closer.
+        if(hz169 > hz2) ccr = I2C_CCR_FS | I2C_CCR_DUTY | ccr169;
+        else ccr = I2C_CCR_FS | ccr2;
+        I2Cx -> TRISE = (mhz * AMP_I2C_FM_TRISE_NS) / 1000 + 1;
+    }
+
+    I2Cx -> CR2 = (I2Cx -> CR2 & ~(I2C_CR2_FREQ)) | mhz;
+    I2Cx -> CCR = ccr;
+
+    if(achieved) *achieved = pclk / (_i2cCcrCycles(ccr) * (ccr & I2C_CCR_CCR));
+    return 1;
+}
+
+// Sets up the read phase of the running transaction.
+static void _i2cRxPhase(i2cPort* port, i2cTransaction* txn){
+    port -> phase = I2C_PHASE_RX;
+    port -> index = 0;
+    port -> rxPec = (txn -> flags & I2C_TXN_PEC) != 0;
+    port -> rxBlock = (txn -> flags & I2C_TXN_BLOCK_READ) != 0;
+    port -> rxBadCount = 0;
+    port -> rxTotal = txn -> rxLen + port -> rxPec;
+}
+
+// Starts the transaction at the head of the queue. Call with interrupts
+// masked or from the I2C interrupts.
+static void _i2cStart(i2cPort* port){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    i2cTransaction* txn = port -> head;
+
+    // A 10-bit read always begins with the address in write direction, so
+    // it takes the zero-length write path into a repeated START.
+    if((txn -> txLen == 0) && (txn -> rxLen != 0)
+            && !(txn -> addr & I2C_ADDR_10BIT)){
+        _i2cRxPhase(port, txn);
+    } else {
+        port -> phase = I2C_PHASE_TX;
+        port -> index = 0;
+    }
+    port -> pecError = 0;
+
+    _i2cStopWait(I2Cx);
+    I2Cx -> CR1     &=  ~(I2C_CR1_POS);
+    I2Cx -> CR2     =   (I2Cx -> CR2 & ~(I2C_CR2_ITBUFEN))
+                        | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    I2Cx -> CR1     |=  I2C_CR1_START;
+}
+
+// Retires the running transaction and starts the next one before calling
+// back, so the bus stays busy.
+static void _i2cComplete(i2cPort* port, i2cStatus status){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    i2cTransaction* txn = port -> head;
+
+    if(port -> dmaActive) _i2cDmaStop(port);
+    port -> addrSent = 0;
+
+    port -> head = txn -> next;
+    if(port -> head == 0) port -> tail = 0;
+
+    if(port -> head){
+        _i2cStart(port);
+    } else {
+        _i2cIrqIdle(port);
+        _i2cStopWait(I2Cx);
+        I2Cx -> CR1 =   (I2Cx -> CR1 & ~(I2C_CR1_POS)) | I2C_CR1_ACK;
+    }
+
+    txn -> status = status;
+    if(txn -> callback) txn -> callback(I2Cx, txn);
+}
+
+// Pulls the running transaction off the queue without starting the next
+// one, for when the bus has to be recovered first. Returns it, or 0.
+static i2cTransaction* _i2cAbort(i2cPort* port){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    i2cTransaction* txn = port -> head;
+
+    I2Cx -> CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN);
+    if(port -> dmaActive) _i2cDmaStop(port);
+    port -> addrSent = 0;
+    port -> slaveState = I2C_SLAVE_IDLE;
+    if(txn == 0) return 0;
+
+    port -> head = txn -> next;
+    if(port -> head == 0) port -> tail = 0;
+    return txn;
+}
+
+// Queues behind the running transaction and anything of the same or higher
+// priority. The head is on the bus already and is never displaced.
+static void _i2cInsert(i2cPort* port, i2cTransaction* txn){
+    i2cTransaction* prev = port -> head;
+
+    while((prev -> next != 0) && (prev -> next -> priority >= txn -> priority)){
+        prev = prev -> next;
+    }
+
+    txn -> next = prev -> next;
+    prev -> next = txn;
+    if(txn -> next == 0) port -> tail = txn;
+}
+
+// Takes a transaction that hasn't started yet back out of the queue.
+static void _i2cUnlink(i2cPort* port, i2cTransaction* txn){
+    i2cTransaction* prev = port -> head;
+
+    while((prev != 0) && (prev -> next != txn)) prev = prev -> next;
+    if(prev == 0) return;
+
+    prev -> next = txn -> next;
+    if(port -> tail == txn) port -> tail = prev;
+}
+
+// Bit-bangs the recovery sequence on the pins as plain open-drain outputs.
+// Returns 1 if both lines float high afterwards.
+static uint8_t _i2cBusClear(i2cPort* port){
+    GPIO_TypeDef* GPIOx = port -> GPIOx;
+    uint16_t scl = (1 << port -> sclPin);
+    uint16_t sda = (1 << port -> sdaPin);
+    uint32_t moder = GPIOx -> MODER;
+    uint32_t mask = (0x03 << (2 * port -> sclPin))
+        | (0x03 << (2 * port -> sdaPin));
+    uint32_t start;
+    uint8_t i;
+
+    GPIOx -> BSRRL  =   scl | sda;
+    GPIOx -> MODER  =   (moder & ~mask) | (0x01 << (2 * port -> sclPin))
+                        | (0x01 << (2 * port -> sdaPin));
+
+    // Nine clocks walk any slave that was mid-byte through the rest of it
+    // and its ACK slot, after which it lets go of SDA (UM10204 3.1.16).
+    for(i = 0; i < 9; i++){
+        GPIOx -> BSRRH = scl;
+        timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+        GPIOx -> BSRRL = scl;
+
+        // Honour clock stretching, but not forever.
+        start = timebaseCyclesGet();
+        while( !(GPIOx -> IDR & scl)){
+            if(timebaseExpired(start, AMP_I2C_STOP_TIMEOUT_US)) break;
+        }
+        timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+    }
+
+    // STOP: SDA rises while SCL is high.
+    GPIOx -> BSRRH = scl;
+    timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+    GPIOx -> BSRRH = sda;
+    timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+    GPIOx -> BSRRL = scl;
+    timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+    GPIOx -> BSRRL = sda;
+    timebaseDelayUs(AMP_I2C_RECOVER_HALF_US);
+
+    i = ((GPIOx -> IDR & (scl | sda)) == (scl | sda));
+
+    GPIOx -> MODER = moder;
+    return i;
+}
+
+// Ends a slave transfer and reports any registers the master wrote.
+static void _i2cSlaveEnd(i2cPort* port){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    uint8_t wrote = (port -> slaveState == I2C_SLAVE_RX_DATA)
+        && (port -> slaveIndex > port -> slavePtr);
+
+    if(port -> dmaActive) _i2cDmaStop(port);
+    I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+    port -> slaveState = I2C_SLAVE_IDLE;
+
+    if(wrote && port -> slaveCallback){
+        port -> slaveCallback(I2Cx, port -> slavePtr,
+                port -> slaveIndex - port -> slavePtr);
+    }
+}
+
+// Master reading: first byte by hand, the rest by DMA where available.
+static void _i2cSlaveTxStart(i2cPort* port){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    uint16_t index = port -> slavePtr;
+
+    port -> slaveState = I2C_SLAVE_TX;
+
+    // Writing DR also replaces any byte left over from a read the master
+    // cut short with a NACK.
+    if(index < port -> slaveSize) I2Cx -> DR = port -> slaveRegs[index++];
+    else I2Cx -> DR = AMP_I2C_SLAVE_PAD;
+
+    if(port -> dmaReady
+            && ((port -> slaveSize - index) >= AMP_I2C_DMA_MIN_LEN)){
+        _i2cDmaStart(port, port -> cfg -> txStream,
+                port -> cfg -> txStreamNum, &(port -> slaveRegs[index]),
+                port -> slaveSize - index);
+        index = port -> slaveSize;
+        I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+    } else {
+        I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+    }
+
+    port -> slaveIndex = index;
+}
+
+// Events while addressed as a slave. SCL is only stretched while ADDR is
+// pending, and when the master reads on past the end of a DMA burst.
+static void _i2cSlaveEvent(i2cPort* port, uint32_t sr1){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    uint8_t data;
+
+    if(sr1 & I2C_SR1_ADDR){
+        // A repeated START ends the write that set the pointer.
+        if(port -> slaveState != I2C_SLAVE_IDLE) _i2cSlaveEnd(port);
+
+        // Reading SR2 clears ADDR.
+        if(I2Cx -> SR2 & I2C_SR2_TRA){
+            _i2cSlaveTxStart(port);
+        } else {
+            port -> slaveState = I2C_SLAVE_RX_REG;
+            I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+        }
+        return;
+    }
+
+    if((sr1 & I2C_SR1_RXNE) && (port -> slaveState != I2C_SLAVE_TX)){
+        data = I2Cx -> DR;
+        if(port -> slaveState == I2C_SLAVE_RX_REG){
+            port -> slavePtr = data;
+            port -> slaveIndex = data;
+            port -> slaveState = I2C_SLAVE_RX_DATA;
+        } else if(port -> slaveIndex < port -> slaveSize){
+            port -> slaveRegs[port -> slaveIndex++] = data;
+        }
+    }
+
+    if(port -> slaveState == I2C_SLAVE_TX){
+        if(port -> dmaActive){
+            // Burst done and DR empty: pad by interrupt from here on.
+            if(!(sr1 & I2C_SR1_BTF)
+                    || (port -> cfg -> txStream -> NDTR != 0)){
+                return;
+            }
+            _i2cDmaStop(port);
+            I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+        }
+
+        if(sr1 & (I2C_SR1_TXE | I2C_SR1_BTF)){
+            if(port -> slaveIndex < port -> slaveSize){
+                I2Cx -> DR = port -> slaveRegs[port -> slaveIndex++];
+            } else {
+                I2Cx -> DR = AMP_I2C_SLAVE_PAD;
+            }
+        }
+    }
+
+    // Cleared by the SR1 read and a write to CR1.
+    if(sr1 & I2C_SR1_STOPF){
+        I2Cx -> CR1 |= I2C_CR1_PE;
+        _i2cSlaveEnd(port);
+    }
+}
+
+// ADDR in receive mode, RM0368 27.3.3 "Master receiver": how the last
+// bytes get NACKed depends on how many there are. With PEC, the PEC bit
+// goes with the NACK, which then lands on the PEC byte (27.3.8).
+static void _i2cRxAddr(i2cPort* port, i2cTransaction* txn){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    uint32_t pec = port -> rxPec ? I2C_CR1_PEC : 0;
+
+    if(port -> rxBlock){
+        // Length unknown until the count byte: take bytes on RXNE.
+        I2Cx -> CR1 |= I2C_CR1_ACK;
+        (void)I2Cx -> SR2;
+        I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+    } else if(_i2cDmaUse(port, port -> rxTotal)){
+        // LAST makes the peripheral NACK the byte after the DMA's
+        // next-to-last one by itself; STOP follows from the DMA interrupt.
+        I2Cx -> CR1 |= I2C_CR1_ACK;
+        I2Cx -> CR2 = (I2Cx -> CR2 & ~(I2C_CR2_ITBUFEN)) | I2C_CR2_LAST;
+        _i2cDmaStart(port, port -> cfg -> rxStream,
+                port -> cfg -> rxStreamNum, txn -> rxBuf, txn -> rxLen);
+        (void)I2Cx -> SR2;
+    } else if(port -> rxTotal == 1){
+        // NACK the only byte, then STOP as soon as ADDR is cleared.
+        I2Cx -> CR1 &= ~(I2C_CR1_ACK);
+        (void)I2Cx -> SR2;
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+    } else if(port -> rxTotal == 2){
+        // POS moves the NACK to the second byte; both land before BTF.
+        I2Cx -> CR1 = (I2Cx -> CR1 & ~(I2C_CR1_ACK)) | I2C_CR1_POS | pec;
+        (void)I2Cx -> SR2;
+        I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+    } else {
+        // N > 2: take bytes on RXNE until 3 remain, then finish on BTF.
+        I2Cx -> CR1 |= I2C_CR1_ACK;
+        (void)I2Cx -> SR2;
+        if(port -> rxTotal > 3) I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+        else I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+    }
+}
+
+// Stores one received byte. The PEC byte was checked by the hardware and is
+// dropped; an SMBus block count fixes how many bytes are left.
+static void _i2cRxStore(i2cPort* port, i2cTransaction* txn, uint8_t data){
+    uint16_t count = data;
+
+    if(port -> index < (port -> rxTotal - port -> rxPec)){
+        txn -> rxBuf[port -> index] = data;
+    }
+    port -> index++;
+
+    if( !(port -> rxBlock)) return;
+    port -> rxBlock = 0;
+
+    // SMBus allows 1-32 bytes. Otherwise take what fits, skip the PEC and
+    // report it.
+    if((count == 0) || (count > txn -> rxLen - 1)){
+        count = (count == 0) ? 1 : txn -> rxLen - 1;
+        port -> rxPec = 0;
+        port -> rxBadCount = 1;
+    }
+    port -> rxTotal = 1 + count + port -> rxPec;
+}
+
+// Result of a finished read: the byte count and the hardware PEC check.
+static i2cStatus _i2cRxStatus(i2cPort* port){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+
+    if(port -> rxBadCount) return I2C_ERR_SIZE;
+    if( !(port -> rxPec)) return I2C_OK;
+
+    if(I2Cx -> SR1 & I2C_SR1_PECERR){
+        I2Cx -> SR1 = ~(I2C_SR1_PECERR) & 0xFFFF;
+        port -> pecError = 1;
+    }
+    return port -> pecError ? I2C_ERR_PEC : I2C_OK;
+}
+
+static void _i2cRxEvent(i2cPort* port, i2cTransaction* txn, uint32_t sr1){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+    uint16_t remaining = port -> rxTotal - port -> index;
+    uint32_t pec = port -> rxPec ? I2C_CR1_PEC : 0;
+
+    // The DMA interrupt finishes DMA reads.
+    if(port -> dmaActive) return;
+
+    if((sr1 & I2C_SR1_BTF) && (remaining <= 3) && (port -> rxTotal > 1)
+            && !(port -> rxBlock)){
+        if(remaining == 3){
+            // Byte N-2 in DR, N-1 in the shift register: NACK byte N.
+            I2Cx -> CR1 = (I2Cx -> CR1 & ~(I2C_CR1_ACK)) | pec;
+            _i2cRxStore(port, txn, I2Cx -> DR);
+        } else {
+            // Bytes N-1 and N both held, STOP before reading them.
+            I2Cx -> CR1 |= I2C_CR1_STOP;
+            _i2cRxStore(port, txn, I2Cx -> DR);
+            _i2cRxStore(port, txn, I2Cx -> DR);
+            _i2cComplete(port, _i2cRxStatus(port));
+        }
+        return;
+    }
+
+    if(!(sr1 & I2C_SR1_RXNE) || (remaining == 0)) return;
+
+    _i2cRxStore(port, txn, I2Cx -> DR);
+    remaining = port -> rxTotal - port -> index;
+
+    if(remaining == 0){
+        _i2cComplete(port, _i2cRxStatus(port));
+    } else if(remaining == 1){
+        // Only after a short SMBus block count: the last byte is on the wire
+        // already, NACK it while its ACK bit is still to come.
+        I2Cx -> CR1 = (I2Cx -> CR1 & ~(I2C_CR1_ACK)) | I2C_CR1_STOP | pec;
+    } else if(remaining == 3){
+        I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+    }
+}
+
+static void _i2cTxEvent(i2cPort* port, i2cTransaction* txn, uint32_t sr1){
+    I2C_TypeDef* I2Cx = port -> cfg -> I2Cx;
+
+    // DMA writes: BTF with the stream drained means the last byte is out,
+    // no DMA interrupt needed.
+    if(port -> dmaActive){
+        if(!(sr1 & I2C_SR1_BTF) || (port -> cfg -> txStream -> NDTR != 0)){
+            return;
+        }
+        _i2cDmaStop(port);
+        port -> index = txn -> txLen;
+    }
+
+    if((sr1 & I2C_SR1_TXE) && (port -> index < txn -> txLen)){
+        I2Cx -> DR = txn -> txBuf[port -> index++];
+        // Last byte loaded: wait for BTF rather than TXE from here. A write
+        // with PEC sends it straight after this byte.
+        if(port -> index == txn -> txLen){
+            I2Cx -> CR2 &= ~(I2C_CR2_ITBUFEN);
+            if((txn -> flags & I2C_TXN_PEC) && (txn -> rxLen == 0)){
+                I2Cx -> CR1 |= I2C_CR1_PEC;
+            }
+        }
+        return;
+    }
+
+    if(!(sr1 & I2C_SR1_BTF) || (port -> index < txn -> txLen)) return;
+
+    if(txn -> rxLen){
+        _i2cRxPhase(port, txn);
+        I2Cx -> CR1 |= I2C_CR1_START;
+    } else {
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        _i2cComplete(port, I2C_OK);
+    }
+}
+
+
+uint8_t i2cInit(I2C_TypeDef* I2Cx, GPIO_TypeDef* GPIOx, uint8_t sclPin,
         uint8_t sdaPin, uint8_t afMode){
 
-    // Enable the I2C and GPIO Clocks in the RCC
-    // NOTE: Change this line to the appropriate GPIOxEN
-    RCC -> AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
+    i2cPort* port = _i2cPortGet(I2Cx);
+
+    // Re-init: forget anything queued under the previous configuration.
+    if(port != 0){
+        if(port -> dmaActive) _i2cDmaStop(port);
+        port -> head = 0;
+        port -> tail = 0;
+        port -> slaveRegs = 0;
+        port -> slaveState = I2C_SLAVE_IDLE;
+        port -> smbus = 0;
+        port -> smbusAlert = 0;
+        port -> GPIOx = GPIOx;
+        port -> sclPin = sclPin;
+        port -> sdaPin = sdaPin;
+    }
+
+    // Enable the GPIO Clock from its position on AHB1 (GPIOA, GPIOB, ... are
+    // 0x400 apart).
+    RCC -> AHB1ENR |= (1UL << (((uint32_t)GPIOx - GPIOA_BASE) >> 10));
 
     // Set GPIO Pins to AF Mode, Medium Speed, PullUp, OpenDrain
     GPIOx -> MODER      |=  (0x02 << (2 * sclPin) | (0x02 << (2 * sdaPin)));
@@ -56,7 +799,8 @@ void i2cInit(I2C_TypeDef* I2Cx, GPIO_TypeDef* GPIOx, uint8_t sclPin,
     else GPIOx -> AFR[0] |= (afMode << (4 * sdaPin));
 
     // Enable I2C Core Clock
-    RCC -> APB1ENR |= RCC_APB1ENR_I2C1EN;
+    if(port != 0) RCC -> APB1ENR |= port -> cfg -> rccEnBit;
+    else RCC -> APB1ENR |= RCC_APB1ENR_I2C1EN;
 
     // Disable the I2C Peripheral
     I2Cx -> CR1     &=      ~(I2C_CR1_PE);
@@ -64,7 +808,7 @@ void i2cInit(I2C_TypeDef* I2Cx, GPIO_TypeDef* GPIOx, uint8_t sclPin,
     // Set up the Second Control Register
     // NOTE: Users, please comment out unnecessary bits.
     I2Cx -> CR2     =   (0
-                        | (0x0010)    // Frequency
+                        // FREQ is filled in from PCLK1 below
                         // | I2C_CR2_ITERREN       // Error Int Enable
                         // | I2C_CR2_ITEVTEN       // Event Int Enable
                         // | I2C_CR2_ITBUFEN       // Buffer Int Enable
@@ -88,39 +832,54 @@ void i2cInit(I2C_TypeDef* I2Cx, GPIO_TypeDef* GPIOx, uint8_t sclPin,
                         // | I2C_CR1_SWRST         // Soft Reset
                         );
 
-    //TODO: THIS CODE IS NOT FINAL, TESTING ONLY, RESEARCH!
-    I2Cx -> CCR     =   (0x800d);
-    I2Cx -> TRISE   =   (5);
     I2Cx -> OAR1    =   (1);
 
+    // CR2 FREQ, CCR (mode, duty, divider) and TRISE from the live PCLK1.
+    // CCR = 0 is not allowed with PE set, so leave the peripheral off if
+    // AMP_I2C_SPEED can't be reached from this clock.
+    if(!_i2cTimingConfigure(I2Cx, AMP_I2C_SPEED, 0)) return 0;
+
     // Re-Enable the I2C Peripheral
     I2Cx -> CR1     |=  I2C_CR1_PE;
+    return 1;
+}
 
+uint8_t i2cSpeedSet(I2C_TypeDef* I2Cx, uint32_t speed, uint32_t* achieved){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t pe = I2Cx -> CR1 & I2C_CR1_PE;
+    uint8_t ok;
+
+    // Only retime an idle bus.
+    if((port != 0) && (port -> head != 0)) return 0;
+    if(I2Cx -> SR2 & I2C_SR2_BUSY) return 0;
+
+    I2Cx -> CR1 &= ~(I2C_CR1_PE);
+    ok = _i2cTimingConfigure(I2Cx, speed, achieved);
+    I2Cx -> CR1 |= pe;
+
+    return ok;
+}
+
+uint32_t i2cSpeedGet(I2C_TypeDef* I2Cx){
+    uint32_t ccr = I2Cx -> CCR;
+
+    if((ccr & I2C_CCR_CCR) == 0) return 0;
+    return rccPclk1Get() / (_i2cCcrCycles(ccr) * (ccr & I2C_CCR_CCR));
 }
 
-/** I2C Send Start
- * @brief Sends the Start Bit on the I2C Peripheral.
- * @param *I2Cx: Which peripheral to send the Start bit over.
- */
 void i2cSendStart(I2C_TypeDef* I2Cx){
     I2Cx -> CR1     |=  I2C_CR1_START;
+    return; 
 }
 
-/** I2C Send Stop
- * @brief Sends the Stop Bit on the I2C Peripheral.
- * @param *I2Cx: Which peripheral to send the Stop bit over.
- */
 void i2cSendStop(I2C_TypeDef* I2Cx){
     I2Cx -> CR1     |=  I2C_CR1_STOP;
+    return;
 }
 
-/** I2C Send 7 Bit Address
- * @brief Sends the 7 Bit Address call over the I2C peripheral.
- * @param *I2Cx: Which peripheral to send the address over.
- * @param addr: 7 Bit Address
- * @param dir: 0 = Write, 1 = Read
- */
 void i2cSendAddr7bit(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t dir){
+
+    // Check Direction Bit, then send with the address
     if (dir != 0){
         addr = (addr << 1) | 0x01;
     } else {
@@ -130,61 +889,676 @@ void i2cSendAddr7bit(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t dir){
     I2Cx -> DR  = addr;
 }
 
-/** I2C Send Byte
- * @brief Sends an 8 bit data value over the I2C peripheral.
- * @param *I2Cx: Which peripheral to send the data through.
- * @param data: byte to send
- * @retval void
- */
+void i2cSendAddr10bitHeader(I2C_TypeDef* I2Cx, uint16_t addr, uint8_t dir){
+    I2Cx -> DR  = AMP_I2C_HEADER10(addr) | (dir != 0);
+}
+
+void i2cSendAddr10bitLow(I2C_TypeDef* I2Cx, uint16_t addr){
+    I2Cx -> DR  = addr & 0xFF;
+}
+
 void i2cSendData(I2C_TypeDef* I2Cx, uint8_t data){
     I2Cx -> DR = data;
+    return; 
 }
 
-/** I2C Receive Byte
- * @brief Retreives the data on the I2C peripheral.
- * @param *I2Cx: Which peripheral to receive data from.
- * @retval Byte pulled from I2C Data Register
- */
 uint8_t i2cRecvData(I2C_TypeDef* I2Cx){
     return (uint8_t) I2Cx -> DR;
 }
 
-/** I2C State Check
- * @brief Check the state of both status registers on the I2C Peripheral.
- * @param *I2Cx: Where x can be 1, 2, or 3.
- * @param i2cStateSR1: Status Register 1 state desired.
- * @param i2cStateSR2: Status Register 2 state desired.
- * @retval Will return 1 for success, 0 for failure.
- * 
- * TODO: Don't like the fact that StdPeriph uses single variable for 
- * I2C_CheckEvent(), but that allows them to use preprocessor macros for 
- * states, giving better readability. Think about this one and look for a 
- * desired solution.
- */
 uint8_t i2cStateCheck(I2C_TypeDef* I2Cx, uint16_t stateSR1, uint16_t stateSR2){
     uint16_t i2cSR1Mask = (I2Cx -> SR1) & stateSR1;
     uint16_t i2cSR2Mask = (I2Cx -> SR2) & stateSR2;
 
+    // If State does not match input, return 0
     if ( (stateSR1 != 0) && (i2cSR1Mask != stateSR1) ) return 0;
     if ( (stateSR2 != 0) && (i2cSR2Mask != stateSR2) ) return 0;
 
+    // If State does match input, return 1;
     return 1;
 }
 
-/** I2C Activate ACK
- * @brief Activates the ACK feature of the given I2C Peripheral
- * @param *I2Cx: Which peripheral to send the ACK bit over.
- * @retval Byte pulled from I2C Data Register
- */
 void i2cActivateAck(I2C_TypeDef* I2Cx){
     I2Cx -> CR1 |= I2C_CR1_ACK; 
+    return; 
 }
 
-/** I2C Deactivate ACK
- * @brief Activates the ACK feature of the given I2C Peripheral
- * @param *I2Cx: Which peripheral to send the ACK bit over.
- * @retval Byte pulled from I2C Data Register
- */
 void i2cDeactivateAck(I2C_TypeDef* I2Cx){
     I2Cx -> CR1 &= ~(I2C_CR1_ACK); 
+    return; 
+}
+
+uint8_t i2cSubmit(I2C_TypeDef* I2Cx, i2cTransaction* txn){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || (txn == 0)) return 0;
+    if(((txn -> txBuf == 0) && (txn -> txLen != 0))
+            || ((txn -> rxBuf == 0) && (txn -> rxLen != 0))){
+        txn -> status = I2C_ERR_PARAM;
+        return 0;
+    }
+    // PEC needs the SMBus engine, a block read room for count and data.
+    if(((txn -> flags & I2C_TXN_PEC) && !(port -> smbus))
+            || ((txn -> flags & I2C_TXN_BLOCK_READ) && (txn -> rxLen < 2))){
+        txn -> status = I2C_ERR_PARAM;
+        return 0;
+    }
+
+    txn -> status = I2C_PENDING;
+    txn -> next = 0;
+
+    primask = _i2cCriticalEnter();
+    if(port -> head == 0){
+        port -> head = txn;
+        port -> tail = txn;
+        _i2cStart(port);
+    } else if(port -> tail -> priority >= txn -> priority){
+        // Common case, nothing to overtake.
+        port -> tail -> next = txn;
+        port -> tail = txn;
+    } else {
+        _i2cInsert(port, txn);
+    }
+    _i2cCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> evIrq);
+    NVIC_EnableIRQ(port -> cfg -> erIrq);
+    return 1;
+}
+
+uint8_t i2cIdle(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    return (port == 0) || (port -> head == 0);
+}
+
+i2cStatus i2cTransfer(I2C_TypeDef* I2Cx, i2cTransaction* txn,
+        uint32_t timeoutUs){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t start;
+    uint32_t primask;
+
+    if(txn == 0) return I2C_ERR_PARAM;
+    if(!i2cSubmit(I2Cx, txn)) return I2C_ERR_PARAM;
+
+    start = timebaseCyclesGet();
+    while(txn -> status == I2C_PENDING){
+        if( !timebaseExpired(start, timeoutUs)) continue;
+
+        primask = _i2cCriticalEnter();
+        if(txn -> status != I2C_PENDING){
+            // Finished just in time.
+            _i2cCriticalExit(primask);
+        } else if(port -> head == txn){
+            // Stuck on the bus: freeze it so no interrupt can retire it
+            // behind our back, then recovery fails it with a timeout.
+            I2Cx -> CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN
+                    | I2C_CR2_ITERREN);
+            if(port -> dmaActive) _i2cDmaStop(port);
+            _i2cCriticalExit(primask);
+            i2cBusRecover(I2Cx);
+        } else {
+            // Never got the bus, nothing to recover.
+            _i2cUnlink(port, txn);
+            txn -> status = I2C_ERR_TIMEOUT;
+            _i2cCriticalExit(primask);
+        }
+        break;
+    }
+
+    return txn -> status;
+}
+
+i2cStatus i2cMemRead(I2C_TypeDef* I2Cx, uint16_t dev, uint8_t reg,
+        uint8_t* buf, uint16_t len){
+    i2cTransaction txn = {
+        .addr = dev,
+        .txBuf = &reg, .txLen = 1,
+        .rxBuf = buf, .rxLen = len,
+    };
+
+    if((buf == 0) || (len == 0)) return I2C_ERR_PARAM;
+    return i2cTransfer(I2Cx, &txn, AMP_I2C_TIMEOUT_US);
+}
+
+i2cStatus i2cMemWrite(I2C_TypeDef* I2Cx, uint16_t dev, uint8_t reg,
+        const uint8_t* buf, uint16_t len){
+    uint8_t frame[1 + AMP_I2C_MEM_WRITE_MAX];
+    i2cTransaction txn = {
+        .addr = dev,
+        .txBuf = frame, .txLen = 1 + len,
+    };
+
+    if(((buf == 0) && (len != 0)) || (len > AMP_I2C_MEM_WRITE_MAX)){
+        return I2C_ERR_PARAM;
+    }
+
+    // Register and data have to go out back to back in one write.
+    frame[0] = reg;
+    memcpy(&frame[1], buf, len);
+
+    return i2cTransfer(I2Cx, &txn, AMP_I2C_TIMEOUT_US);
+}
+
+i2cStatus i2cScan(I2C_TypeDef* I2Cx, uint8_t* map, uint8_t* ids,
+        uint8_t idReg){
+    i2cTransaction probe = { 0 };
+    i2cStatus status;
+    uint8_t addr;
+
+    if(map == 0) return I2C_ERR_PARAM;
+    memset(map, 0, I2C_SCAN_MAP_SIZE);
+
+    // 0x00-0x07 and 0x78-0x7F are reserved (general call, CBUS, HS-mode,
+    // 10-bit headers) and never probed.
+    for(addr = 0x08; addr < 0x78; addr++){
+        // Address only, no data: ACK or NACK is all we ask of a device.
+        probe.addr = addr;
+        status = i2cTransfer(I2Cx, &probe, AMP_I2C_SCAN_TIMEOUT_US);
+
+        // Nothing further will get through a bus that can't be freed.
+        if(status == I2C_ERR_BUS_STUCK) return status;
+        if(status != I2C_OK) continue;
+
+        map[addr >> 3] |= (1 << (addr & 0x07));
+        if(ids) i2cMemRead(I2Cx, addr, idReg, &ids[addr], 1);
+    }
+
+    return I2C_OK;
+}
+
+uint8_t i2cSmbusEnable(I2C_TypeDef* I2Cx, uint8_t pec,
+        GPIO_TypeDef* alertGPIO, uint8_t alertPin,
+        i2cSmbusAlertCallback alert){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || (port -> head != 0)) return 0;
+    if((alert != 0) && (alertGPIO == 0)) return 0;
+
+    if(alertGPIO){
+        RCC -> AHB1ENR |= (1UL << (((uint32_t)alertGPIO - GPIOA_BASE) >> 10));
+
+        // AF, pulled up: SMBA is open-drain and active low.
+        alertGPIO -> MODER  =   (alertGPIO -> MODER
+                                & ~(0x03 << (2 * alertPin)))
+                                | (0x02 << (2 * alertPin));
+        alertGPIO -> PUPDR  =   (alertGPIO -> PUPDR
+                                & ~(0x03 << (2 * alertPin)))
+                                | (0x01 << (2 * alertPin));
+        alertGPIO -> AFR[alertPin >> 3] =
+            (alertGPIO -> AFR[alertPin >> 3] & ~(0x0F << (4 * (alertPin & 7))))
+            | (AMP_I2C_SMBA_AF << (4 * (alertPin & 7)));
+    }
+
+    primask = _i2cCriticalEnter();
+    I2Cx -> CR1     &=  ~(I2C_CR1_PE);
+    I2Cx -> CR1     |=  (0
+                        | I2C_CR1_SMBUS         // SMBus Mode
+                        | I2C_CR1_SMBTYPE       // SMBus Host
+                        | I2C_CR1_ENPEC         // PEC Enable
+                        | (alert ? I2C_CR1_ALERT : 0)   // SMBA Detection
+                        );
+    I2Cx -> SR1     =   ~(AMP_I2C_SR1_SMBUS) & 0xFFFF;
+    I2Cx -> CR1     |=  I2C_CR1_PE;
+
+    port -> smbus = 1;
+    port -> smbusPec = pec;
+    port -> smbusAlert = alert;
+    if(alert) I2Cx -> CR2 |= I2C_CR2_ITERREN;
+    _i2cCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> evIrq);
+    NVIC_EnableIRQ(port -> cfg -> erIrq);
+    return 1;
+}
+
+void i2cSmbusDisable(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || !(port -> smbus)) return;
+
+    primask = _i2cCriticalEnter();
+    port -> smbus = 0;
+    port -> smbusAlert = 0;
+    I2Cx -> CR1 &= ~(I2C_CR1_PE);
+    I2Cx -> CR1 &= ~(I2C_CR1_SMBUS | I2C_CR1_SMBTYPE | I2C_CR1_ENPEC
+            | I2C_CR1_ALERT);
+    I2Cx -> CR1 |= I2C_CR1_PE;
+    if(port -> head == 0) _i2cIrqIdle(port);
+    _i2cCriticalExit(primask);
+}
+
+// Runs one SMBus protocol transaction with the bus's PEC setting.
+static i2cStatus _i2cSmbusTransfer(I2C_TypeDef* I2Cx, uint8_t addr,
+        const uint8_t* tx, uint16_t txLen, uint8_t* rx, uint16_t rxLen,
+        uint8_t flags){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    i2cTransaction txn = {
+        .addr = addr,
+        .txBuf = tx, .txLen = txLen,
+        .rxBuf = rx, .rxLen = rxLen,
+        .flags = flags,
+    };
+
+    if((port == 0) || !(port -> smbus)) return I2C_ERR_PARAM;
+    if(port -> smbusPec) txn.flags |= I2C_TXN_PEC;
+
+    return i2cTransfer(I2Cx, &txn, AMP_I2C_SMBUS_TIMEOUT_US);
+}
+
+i2cStatus i2cSmbusReadWord(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t* value){
+    uint8_t rx[2];
+    i2cStatus status;
+
+    if(value == 0) return I2C_ERR_PARAM;
+
+    status = _i2cSmbusTransfer(I2Cx, addr, &cmd, 1, rx, 2, 0);
+    if(status == I2C_OK) *value = rx[0] | (rx[1] << 8);
+    return status;
+}
+
+i2cStatus i2cSmbusWriteWord(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t value){
+    uint8_t tx[3] = { cmd, value & 0xFF, value >> 8 };
+
+    return _i2cSmbusTransfer(I2Cx, addr, tx, 3, 0, 0, 0);
+}
+
+i2cStatus i2cSmbusProcessCall(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint16_t value, uint16_t* result){
+    uint8_t tx[3] = { cmd, value & 0xFF, value >> 8 };
+    uint8_t rx[2];
+    i2cStatus status;
+
+    if(result == 0) return I2C_ERR_PARAM;
+
+    status = _i2cSmbusTransfer(I2Cx, addr, tx, 3, rx, 2, 0);
+    if(status == I2C_OK) *result = rx[0] | (rx[1] << 8);
+    return status;
+}
+
+i2cStatus i2cSmbusBlockWrite(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        const uint8_t* data, uint8_t len){
+    uint8_t tx[2 + AMP_I2C_SMBUS_BLOCK_MAX];
+
+    if((data == 0) || (len == 0) || (len > AMP_I2C_SMBUS_BLOCK_MAX)){
+        return I2C_ERR_PARAM;
+    }
+
+    tx[0] = cmd;
+    tx[1] = len;
+    memcpy(&tx[2], data, len);
+
+    return _i2cSmbusTransfer(I2Cx, addr, tx, 2 + len, 0, 0, 0);
+}
+
+i2cStatus i2cSmbusBlockRead(I2C_TypeDef* I2Cx, uint8_t addr, uint8_t cmd,
+        uint8_t* data, uint8_t* len){
+    uint8_t rx[1 + AMP_I2C_SMBUS_BLOCK_MAX];
+    i2cStatus status;
+
+    if((data == 0) || (len == 0)) return I2C_ERR_PARAM;
+
+    status = _i2cSmbusTransfer(I2Cx, addr, &cmd, 1, rx, sizeof(rx),
+            I2C_TXN_BLOCK_READ);
+    if((status == I2C_OK) || (status == I2C_ERR_SIZE)){
+        *len = (rx[0] > AMP_I2C_SMBUS_BLOCK_MAX) ? AMP_I2C_SMBUS_BLOCK_MAX
+            : rx[0];
+        memcpy(data, &rx[1], *len);
+    }
+    return status;
+}
+
+i2cStatus i2cSmbusAlertResponse(I2C_TypeDef* I2Cx, uint8_t* addr){
+    uint8_t rx;
+    i2cStatus status;
+
+    if(addr == 0) return I2C_ERR_PARAM;
+
+    // The alerting device with the lowest address wins arbitration and
+    // answers with its address in bits 7:1.
+    status = _i2cSmbusTransfer(I2Cx, AMP_I2C_SMBUS_ARA, 0, 0, &rx, 1, 0);
+    if(status == I2C_OK) *addr = rx >> 1;
+    return status;
+}
+
+i2cStatus i2cEventWait(I2C_TypeDef* I2Cx, uint16_t stateSR1,
+        uint16_t stateSR2, uint32_t timeoutUs){
+    uint32_t start = timebaseCyclesGet();
+    uint16_t errors;
+
+    while( !i2cStateCheck(I2Cx, stateSR1, stateSR2)){
+        errors = I2Cx -> SR1 & AMP_I2C_SR1_ERRORS;
+        if(errors){
+            // Error flags are rc_w0: writing 1 to the others leaves them.
+            I2Cx -> SR1 = ~errors & 0xFFFF;
+
+            // Arbitration loss already put the hardware back in slave mode.
+            if(errors & I2C_SR1_ARLO) return I2C_ERR_ARLO;
+
+            I2Cx -> CR1 |= I2C_CR1_STOP;
+            if(errors & I2C_SR1_AF) return I2C_ERR_NACK;
+            if(errors & I2C_SR1_BERR) return I2C_ERR_BERR;
+            return I2C_ERR_OVR;
+        }
+
+        if(timebaseExpired(start, timeoutUs)){
+            return (i2cBusRecover(I2Cx) == I2C_OK)
+                ? I2C_ERR_TIMEOUT : I2C_ERR_BUS_STUCK;
+        }
+    }
+
+    return I2C_OK;
+}
+
+i2cStatus i2cBusRecover(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    i2cTransaction* txn;
+    uint32_t primask;
+    uint32_t cr1, cr2, ccr, trise, oar1, oar2;
+    uint8_t clear;
+
+    if((port == 0) || (port -> GPIOx == 0)) return I2C_ERR_PARAM;
+
+    NVIC_DisableIRQ(port -> cfg -> evIrq);
+    NVIC_DisableIRQ(port -> cfg -> erIrq);
+
+    primask = _i2cCriticalEnter();
+    txn = _i2cAbort(port);
+    _i2cCriticalExit(primask);
+
+    // SWRST clears every register, so keep the configuration.
+    cr1     =   I2Cx -> CR1 & AMP_I2C_CR1_CONFIG;
+    cr2     =   I2Cx -> CR2 & ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN
+                    | I2C_CR2_ITERREN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+    ccr     =   I2Cx -> CCR;
+    trise   =   I2Cx -> TRISE;
+    oar1    =   I2Cx -> OAR1;
+    oar2    =   I2Cx -> OAR2;
+
+    I2Cx -> CR1 &= ~(I2C_CR1_PE);
+    clear = _i2cBusClear(port);
+
+    // A reset also clears a BUSY flag the peripheral latched from the glitch.
+    I2Cx -> CR1 |=  I2C_CR1_SWRST;
+    I2Cx -> CR1 &=  ~(I2C_CR1_SWRST);
+
+    I2Cx -> CR2     =   cr2;
+    I2Cx -> CCR     =   ccr;
+    I2Cx -> TRISE   =   trise;
+    I2Cx -> OAR1    =   oar1;
+    I2Cx -> OAR2    =   oar2;
+    I2Cx -> CR1     =   cr1 | I2C_CR1_PE;
+
+    // Back to listening for our slave address and SMBALERT.
+    if(port -> slaveRegs) I2Cx -> CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    if(port -> smbusAlert) I2Cx -> CR2 |= I2C_CR2_ITERREN;
+
+    if(txn){
+        txn -> status = clear ? I2C_ERR_TIMEOUT : I2C_ERR_BUS_STUCK;
+        if(txn -> callback) txn -> callback(I2Cx, txn);
+    }
+
+    // Carry on with anything queued behind the failed transaction.
+    primask = _i2cCriticalEnter();
+    if(clear && port -> head) _i2cStart(port);
+    _i2cCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> evIrq);
+    NVIC_EnableIRQ(port -> cfg -> erIrq);
+
+    return clear ? I2C_OK : I2C_ERR_BUS_STUCK;
+}
+
+uint8_t i2cDmaEnable(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+
+    if((port == 0) || (port -> cfg -> txStream == 0)) return 0;
+    if(port -> head != 0) return 0;
+
+    _i2cDmaConfigure(port);
+    port -> dmaEnabled = 1;
+    return 1;
+}
+
+void i2cDmaDisable(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || !(port -> dmaEnabled)) return;
+
+    // Let the running transaction finish on DMA, later ones use interrupts.
+    primask = _i2cCriticalEnter();
+    port -> dmaEnabled = 0;
+    _i2cCriticalExit(primask);
+}
+
+void i2cDmaRxIRQHandler(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    i2cTransaction* txn;
+    uint32_t flags;
+
+    if((port == 0) || (port -> cfg -> rxStream == 0)) return;
+
+    flags = _i2cDmaFlagsGet(port -> cfg -> rxStreamNum);
+    _i2cDmaFlagsClear(port -> cfg -> rxStreamNum, flags);
+
+    txn = port -> head;
+    if((txn == 0) || !(port -> dmaActive)) return;
+
+    if(flags & AMP_I2C_DMA_FLAG_TE){
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        _i2cComplete(port, I2C_ERR_DMA);
+    } else if(flags & AMP_I2C_DMA_FLAG_TC){
+        // Last byte is in memory and was NACKed thanks to LAST.
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        port -> index = txn -> rxLen;
+        _i2cComplete(port, I2C_OK);
+    }
+}
+
+uint8_t i2cSlaveEnable(I2C_TypeDef* I2Cx, uint16_t addr, uint8_t* regs,
+        uint16_t size, i2cSlaveCallback callback){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || (regs == 0) || (size == 0) || (size > 256)) return 0;
+    if(port -> head != 0) return 0;
+
+    // Bulk reads go out by DMA where the port has a stream for them.
+    if(port -> cfg -> txStream) _i2cDmaConfigure(port);
+
+    primask = _i2cCriticalEnter();
+    port -> slaveRegs = regs;
+    port -> slaveSize = size;
+    port -> slaveCallback = callback;
+    port -> slaveState = I2C_SLAVE_IDLE;
+    port -> slavePtr = 0;
+
+    if(addr & I2C_ADDR_10BIT){
+        I2Cx -> OAR1 =  AMP_I2C_OAR1_BIT14 | I2C_OAR1_ADDMODE | (addr & 0x3FF);
+    } else {
+        I2Cx -> OAR1 =  AMP_I2C_OAR1_BIT14 | ((uint32_t)(addr & 0x7F) << 1);
+    }
+    I2Cx -> CR1     =   (I2Cx -> CR1 & ~(I2C_CR1_NOSTRETCH)) | I2C_CR1_ACK;
+    I2Cx -> CR2     |=  I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    _i2cCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> evIrq);
+    NVIC_EnableIRQ(port -> cfg -> erIrq);
+    return 1;
+}
+
+void i2cSlaveDisable(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t primask;
+
+    if((port == 0) || (port -> slaveRegs == 0)) return;
+
+    primask = _i2cCriticalEnter();
+    if(port -> slaveState != I2C_SLAVE_IDLE) _i2cSlaveEnd(port);
+    port -> slaveRegs = 0;
+
+    // Address 0 is the general call, only answered with ENGC.
+    I2Cx -> OAR1 = AMP_I2C_OAR1_BIT14;
+    if(port -> head == 0) _i2cIrqIdle(port);
+    _i2cCriticalExit(primask);
+}
+
+void i2cEvIRQHandler(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    i2cTransaction* txn;
+    uint32_t sr1;
+
+    if(port == 0) return;
+    txn = port -> head;
+    sr1 = I2Cx -> SR1;
+
+    // Anything that isn't part of our own master transfer is for the slave
+    // register map.
+    if(port -> slaveRegs && ((port -> slaveState != I2C_SLAVE_IDLE)
+                || (sr1 & I2C_SR1_STOPF)
+                || ((sr1 & I2C_SR1_ADDR) && !(port -> addrSent)))){
+        _i2cSlaveEvent(port, sr1);
+        return;
+    }
+
+    if(txn == 0){
+        _i2cIrqIdle(port);
+        return;
+    }
+
+    // Start sent: address the slave. Reading SR1 above, then writing DR,
+    // clears SB.
+    if(sr1 & I2C_SR1_SB){
+        port -> addrSent = 1;
+        if(port -> phase == I2C_PHASE_RX){
+            I2Cx -> CR1 |= I2C_CR1_ACK;
+        }
+        if(txn -> addr & I2C_ADDR_10BIT){
+            // Header only; reads reuse the address the write phase set up.
+            I2Cx -> DR = AMP_I2C_HEADER10(txn -> addr)
+                | (port -> phase == I2C_PHASE_RX);
+        } else {
+            I2Cx -> DR = ((txn -> addr & 0x7F) << 1)
+                | (port -> phase == I2C_PHASE_RX);
+        }
+        return;
+    }
+
+    // 10-bit header acknowledged: the low address byte follows, then ADDR.
+    // Reading SR1 above, then writing DR, clears ADD10.
+    if(sr1 & I2C_SR1_ADD10){
+        I2Cx -> DR = txn -> addr & 0xFF;
+        return;
+    }
+
+    // Address acknowledged. Reading SR2 clears ADDR and releases SCL.
+    if(sr1 & I2C_SR1_ADDR){
+        port -> addrSent = 0;
+        if(port -> phase == I2C_PHASE_RX){
+            _i2cRxAddr(port, txn);
+        } else {
+            if(_i2cDmaUse(port, txn -> txLen)){
+                _i2cDmaStart(port, port -> cfg -> txStream,
+                        port -> cfg -> txStreamNum, (uint8_t*)txn -> txBuf,
+                        txn -> txLen);
+                (void)I2Cx -> SR2;
+            } else {
+                (void)I2Cx -> SR2;
+                if(txn -> txLen) I2Cx -> CR2 |= I2C_CR2_ITBUFEN;
+                else _i2cTxEvent(port, txn, I2C_SR1_BTF);
+            }
+        }
+        return;
+    }
+
+    if(port -> phase == I2C_PHASE_RX) _i2cRxEvent(port, txn, sr1);
+    else _i2cTxEvent(port, txn, sr1);
+}
+
+void i2cErIRQHandler(I2C_TypeDef* I2Cx){
+    i2cPort* port = _i2cPortGet(I2Cx);
+    uint32_t sr1 = I2Cx -> SR1;
+    i2cStatus status;
+
+    if(port == 0) return;
+
+    // Error flags are rc_w0: writing 1 to the others leaves them alone.
+    I2Cx -> SR1 = ~(sr1 & (AMP_I2C_SR1_ERRORS | AMP_I2C_SR1_SMBUS)) & 0xFFFF;
+
+    // A device pulled SMBA low, whatever the bus is doing.
+    if((sr1 & I2C_SR1_SMBALERT) && port -> smbusAlert){
+        port -> smbusAlert(I2Cx);
+    }
+
+    // Judged when the read completes, see _i2cRxStatus.
+    if(sr1 & I2C_SR1_PECERR) port -> pecError = 1;
+
+    // A NACK is how a master ends a read from the slave register map.
+    if((port -> slaveState != I2C_SLAVE_IDLE)
+            && (sr1 & (AMP_I2C_SR1_ERRORS | I2C_SR1_TIMEOUT))){
+        _i2cSlaveEnd(port);
+        return;
+    }
+
+    if(port -> head == 0) return;
+
+    if(sr1 & I2C_SR1_ARLO){
+        // The hardware has already dropped back to slave mode, no STOP.
+        status = I2C_ERR_ARLO;
+    } else if(sr1 & I2C_SR1_AF){
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        status = I2C_ERR_NACK;
+    } else if(sr1 & I2C_SR1_BERR){
+        I2Cx -> CR1 |= I2C_CR1_STOP;
+        status = I2C_ERR_BERR;
+    } else if(sr1 & I2C_SR1_OVR){
+        status = I2C_ERR_OVR;
+    } else if(sr1 & I2C_SR1_TIMEOUT){
+        // SCL low past 25ms, or 10ms cumulative stretching. The hardware
+        // has sent STOP already.
+        status = I2C_ERR_TIMEOUT;
+    } else {
+        return;
+    }
+
+    _i2cComplete(port, status);
+}
+
+// Interrupt Vectors
+// These override the weak aliases in the startup file.
+void I2C1_EV_IRQHandler(void){
+    i2cEvIRQHandler(I2C1);
+}
+
+void I2C1_ER_IRQHandler(void){
+    i2cErIRQHandler(I2C1);
+}
+
+void I2C2_EV_IRQHandler(void){
+    i2cEvIRQHandler(I2C2);
+}
+
+void I2C2_ER_IRQHandler(void){
+    i2cErIRQHandler(I2C2);
+}
+
+void I2C3_EV_IRQHandler(void){
+    i2cEvIRQHandler(I2C3);
+}
+
+void I2C3_ER_IRQHandler(void){
+    i2cErIRQHandler(I2C3);
+}
+
+void DMA1_Stream0_IRQHandler(void){
+    i2cDmaRxIRQHandler(I2C1);
+}
+
+void DMA1_Stream2_IRQHandler(void){
+    i2cDmaRxIRQHandler(I2C3);
 }
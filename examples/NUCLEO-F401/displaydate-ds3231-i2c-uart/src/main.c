@@ -5,7 +5,7 @@
  *
  *    Description:  Example of a real time clock derived from a DS3231 module.
  *
- *      Libs Used:  USART I2C
+ *      Libs Used:  USART I2C Console Timebase
  *
  *        Version:  1.0
  *        Created:  01/28/2016 
@@ -21,8 +21,14 @@
 #include <i2c.h>
 #include <stdlib.h>
 #include <mod_ds3231.h>
+#include <timebase.h>
+#include <console.h>
+#include <binlog.h>
+#include <stddef.h>
+#include <string.h>
 
 #define DS3231_MODULE_ADDR 0x68
+#define HEARTBEAT_PERIOD_US 500000
 
 void Delay(uint32_t nCount){
     for(; nCount != 0; nCount--);
@@ -33,54 +39,9 @@ void Delay(uint32_t nCount){
  * I2C Code, so I'm leaving it as a snippet for future use.
  */
 void i2cStatePrint(I2C_TypeDef* I2Cx){
-    uint16_t i2cState;
-    uint8_t i2cStateString[30];
-
-    /*
-    i2cState = I2Cx -> TRISE;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "TRISE = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    i2cState = I2Cx -> CCR;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "CCR = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    i2cState = I2Cx -> CR1;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "CR1 = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    i2cState = I2Cx -> CR2;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "CR2 = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-    */
-
-    i2cState = I2Cx -> DR;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "DR = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    i2cState = I2Cx -> SR1;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "SR1 = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    i2cState = I2Cx -> SR2;
-    itoa(i2cState, i2cStateString, 16);
-    usartStringSend(USART2, "SR2 = "); 
-    usartStringSend(USART2, i2cStateString); 
-    usartStringSend(USART2, "\r\n"); 
-
-    usartStringSend(USART2, "\r\n"); 
+    BINLOG(USART2, "TRISE = %x CCR = %x CR1 = %x CR2 = %x\n"
+            "DR = %x SR1 = %x SR2 = %x\n", I2Cx -> TRISE, I2Cx -> CCR,
+            I2Cx -> CR1, I2Cx -> CR2, I2Cx -> DR, I2Cx -> SR1, I2Cx -> SR2);
 }
 
 void initHeartbeat(){
@@ -89,504 +50,147 @@ void initHeartbeat(){
     GPIOA -> ODR &= ~(1 << 5); 
 }
 
-uint8_t ds3231_readSeconds(){
-    uint8_t i;
+// Reads only the seconds register. Bounded, so a missing or wedged DS3231
+// costs AMP_I2C_TIMEOUT_US per call rather than the board.
+i2cStatus ds3231_readSeconds(uint8_t* seconds){
+    return i2cMemRead(I2C1, DS3231_MODULE_ADDR, DS3231_SECONDS_REGISTER,
+            seconds, 1);
+}
 
-    i2cActivateAck(I2C1);
+void printDateInfo(ds3231Date* dateIn){
+    usartPrintf(USART2,
+            "Display:\r\n"
+            "Hr  = %u\r\n"
+            "Min = %u\r\n"
+            "Sec = %u\r\n"
+            "DOW = %u\r\n"
+            "DOM = %u\r\n"
+            "Mon = %u\r\n"
+            "Yr  = %u\r\n\r\n",
+            dateIn->hour, dateIn->minute, dateIn->second, dateIn->dayOfWeek,
+            dateIn->dayOfMonth, dateIn->month, dateIn->year);
+}
 
-    i2cSendStart(I2C1);
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_MODE_ACTIVE_SR2));
+// Console Commands
+
+// One settable date field: where it lives in ds3231Date and its range.
+typedef struct dateField {
+    const char* name;
+    uint8_t     offset;
+    uint8_t     min;
+    uint8_t     max;
+} dateField;
+
+static const dateField dateFields[] = {
+    { "hour",   offsetof(ds3231Date, hour),         0, 23 },
+    { "min",    offsetof(ds3231Date, minute),       0, 59 },
+    { "sec",    offsetof(ds3231Date, second),       0, 59 },
+    { "dow",    offsetof(ds3231Date, dayOfWeek),    1,  7 },
+    { "dom",    offsetof(ds3231Date, dayOfMonth),   1, 31 },
+    { "month",  offsetof(ds3231Date, month),        1, 12 },
+    { "year",   offsetof(ds3231Date, year),         0, 99 },
+};
+
+#define DATE_FIELD_COUNT (sizeof(dateFields) / sizeof(dateFields[0]))
+
+// Reports a failed DS3231 access; the bus has already been recovered if
+// it was stuck.
+void printI2cError(USART_TypeDef* USARTx, i2cStatus status){
+    BINLOG(USARTx, "DS3231 not responding (I2C error %u)\n", status);
+}
 
-    i2cSendAddr7bit(I2C1, DS3231_MODULE_ADDR, 0);
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR2));
+uint8_t cmdDate(USART_TypeDef* USARTx, uint8_t argc, char* argv[]){
+    ds3231Date currentDate;
+    i2cStatus status;
 
-    i2cSendData(I2C1, DS3231_SECONDS_REGISTER);
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_BYTE_TRANSMITTED_SR1,
-                I2C_STATE_MASTER_BYTE_TRANSMITTED_SR2));
+    (void)argc;
+    (void)argv;
 
-    i2cSendStart(I2C1);
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_MODE_ACTIVE_SR2));
+    status = ds3231_readDate(I2C1, &currentDate);
+    if(status != I2C_OK) printI2cError(USARTx, status);
+    else printDateInfo(&currentDate);
+    return 1;
+}
 
-    i2cSendAddr7bit(I2C1, DS3231_MODULE_ADDR, 1);
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_RECEIVER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_RECEIVER_MODE_ACTIVE_SR2));
+// set <field> <value|+|->: one read-modify-write per command, + and - wrap
+// within the field's range.
+uint8_t cmdSet(USART_TypeDef* USARTx, uint8_t argc, char* argv[]){
+    const dateField* field = 0;
+    ds3231Date currentDate;
+    uint8_t* value;
+    uint32_t newValue;
+    i2cStatus status;
+    uint8_t i;
 
-    while ( !i2cStateCheck(I2C1, I2C_STATE_MASTER_BYTE_RECEIVED_SR1,
-                I2C_STATE_MASTER_BYTE_RECEIVED_SR2));
-    i2cDeactivateAck(I2C1);
-    i2cSendStop(I2C1);
+    (void)argc;     // The console has already checked for two arguments.
 
-    i = i2cRecvData(I2C1);
+    for(i = 0; i < DATE_FIELD_COUNT; i++){
+        if(strcmp(argv[1], dateFields[i].name) == 0) field = &dateFields[i];
+    }
+    if(field == 0) return 0;
 
-    return i;
-}
+    status = ds3231_readDate(I2C1, &currentDate);
+    if(status != I2C_OK){
+        printI2cError(USARTx, status);
+        return 1;
+    }
+    value = (uint8_t*)&currentDate + field -> offset;
+
+    if(strcmp(argv[2], "+") == 0){
+        newValue = (*value >= field -> max) ? field -> min : *value + 1;
+    } else if(strcmp(argv[2], "-") == 0){
+        newValue = (*value <= field -> min) ? field -> max : *value - 1;
+    } else if(!consoleArgToUint(argv[2], &newValue)
+            || (newValue < field -> min) || (newValue > field -> max)){
+        // The console prints the usage line, the log has the range.
+        BINLOG(USARTx, "set: value must be %u-%u\n", field -> min,
+                field -> max);
+        return 0;
+    }
 
-void printDateInfo(ds3231Date* dateIn){
-    uint8_t dateStringBuffer[5] = {0,0,0,0,0};
-    uint8_t i = 0;
-
-    usartStringSend(USART2, "Display:\r\n");
-
-    itoa(dateIn->hour, dateStringBuffer, 10);
-    usartStringSend(USART2, "Hr  = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->minute, dateStringBuffer, 10);
-    usartStringSend(USART2, "Min = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->second, dateStringBuffer, 10);
-    usartStringSend(USART2, "Sec = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->dayOfWeek, dateStringBuffer, 10);
-    usartStringSend(USART2, "DOW = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->dayOfMonth, dateStringBuffer, 10);
-    usartStringSend(USART2, "DOM = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->month, dateStringBuffer, 10);
-    usartStringSend(USART2, "Mon = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n");
-
-    itoa(dateIn->year, dateStringBuffer, 10);
-    usartStringSend(USART2, "Yr  = ");
-    usartStringSend(USART2, dateStringBuffer);
-    usartStringSend(USART2, "\r\n\r\n");
+    *value = newValue;
+    status = ds3231_writeDate(I2C1, &currentDate);
+    if(status != I2C_OK) printI2cError(USARTx, status);
+    else usartPrintf(USARTx, "%s = %u\r\n", field -> name, newValue);
+    return 1;
 }
 
-void checkDateChange(){
-    ds3231Date currentDate;
-    uint8_t termData = usartByteReceive(USART2);
-
-    switch(termData){
-        case 'd':
-            ds3231_readDate(I2C1, &currentDate);
-            printDateInfo(&currentDate);
-            return;
-            break;
-
-        case 'c':
-            configureMenu(&currentDate);
-            return;
-            break;
-
-        case 'h':
-            usartStringSend(USART2, "Help: \r\n");
-            usartStringSend(USART2, "   Configure        - c\r\n");
-            usartStringSend(USART2, "   Display Date     - d\r\n");
-            usartStringSend(USART2, "   Help (This Menu) - h\r\n");
-            usartStringSend(USART2, "\r\n\r\n");
-            return; 
-            break;
+// Lists every device that answers on I2C1, e.g. the DS3231 at 0x68 and
+// its AT24C32 at 0x57.
+uint8_t cmdScan(USART_TypeDef* USARTx, uint8_t argc, char* argv[]){
+    uint8_t map[I2C_SCAN_MAP_SIZE];
+    uint8_t addr;
+    i2cStatus status;
+
+    (void)argc;
+    (void)argv;
+
+    status = i2cScan(I2C1, map, 0, 0);
+    if(status != I2C_OK){
+        BINLOG(USARTx, "Scan failed (I2C error %u)\n", status);
+        return 1;
     }
-}
 
-void configureMenu(){
-    usartStringSend(USART2, "Configure:\r\n");
-    usartStringSend(USART2, "   Hours      - h\r\n");
-    usartStringSend(USART2, "   Minutes    - m\r\n");
-    usartStringSend(USART2, "   Seconds    - s\r\n");
-    usartStringSend(USART2, "   DayOfWeek  - w\r\n");
-    usartStringSend(USART2, "   DayOfMonth - d\r\n");
-    usartStringSend(USART2, "   Month      - l\r\n");
-    usartStringSend(USART2, "   Year       - y\r\n");
-    usartStringSend(USART2, "\r\n\r\n");
-
-    uint8_t termData = usartByteReceive(USART2);
-    switch(termData){
-        case 'h': // Configure Hours Menu
-            usartStringSend(USART2, "Configure Hours:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"00\" - \"23\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Hours by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.hour++;
-                    if (currentDate.hour > 23) currentDate.hour -= 24;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if (termData == '-'){ // Decrement Hours by 1 
-
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.hour == 0) currentDate.hour = 23;
-                    else currentDate.hour--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if ((termData < '0') || (termData > '2')){
-
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Hours Value Manually
-                uint8_t tempHours = 0;
-                
-                // Convert ASCII input to raw number
-                tempHours = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempHours = tempHours + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.hour = tempHours;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        case 'm': // Configure Minutes
-            usartStringSend(USART2, "Configure Minutes:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"00\" - \"59\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Mintues by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.minute++;
-                    if (currentDate.minute > 59) currentDate.minute -= 60;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if (termData == '-'){ // Decrement Minutes by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.minute == 0) currentDate.minute = 59;
-                    else currentDate.minute--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if ((termData < '0') || (termData > '5')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Minutes Value Manually
-                uint8_t tempMinute = 0;
-                
-                // Convert ASCII input to raw number
-                tempMinute = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempMinute = tempMinute + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.minute = tempMinute;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        case 's': // Configure Seconds
-            usartStringSend(USART2, "Configure Seconds:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"00\" - \"59\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Seconds by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.second++;
-                    if (currentDate.second > 59) currentDate.second -= 60;
-                    ds3231_writeDate(I2C1, &currentDate); 
-            } else if (termData == '-'){ // Decrement Seconds by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.second == 0) currentDate.second = 59;
-                    else currentDate.second--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-            } else if ((termData < '0') || (termData > '5')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Seconds Value Manually
-                uint8_t tempSeconds = 0;
-                
-                // Convert ASCII input to raw number
-                tempSeconds = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempSeconds = tempSeconds + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.second = tempSeconds;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        case 'w': // Configure DayOfWeek
-            usartStringSend(USART2, "Configure Weekday:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 1-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"1\" - \"7\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Weekday by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.dayOfWeek++;
-                    if (currentDate.dayOfWeek > 7){
-                        currentDate.dayOfWeek -= 7;
-                    }
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if (termData == '-'){ // Decrement Weekday by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.dayOfWeek--;
-                    if (currentDate.dayOfWeek < 1){
-                        currentDate.dayOfWeek += 7;
-                    }
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if ((termData < '1') || (termData > '7')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Weekday Value Manually
-                uint8_t tempWeekday = 0;
-                
-                // Convert ASCII input to raw number
-                // Then Send to device
-                tempWeekday = (termData - '0');
-
-                // Data finally ready, send to clock. 
-                ds3231Date currentDate;
-                ds3231_readDate(I2C1, &currentDate);
-                currentDate.dayOfWeek = tempWeekday;
-                ds3231_writeDate(I2C1, &currentDate); 
-                return;
-            
-            }
-            break;
-
-        case 'd': // Configure DayOfMonth
-            usartStringSend(USART2, "Configure Seconds:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"01\" - \"31\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Day Of Month by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.dayOfMonth++; 
-                    if (currentDate.dayOfMonth > 31) 
-                        currentDate.dayOfMonth -= 31;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if (termData == '-'){ // Decrement Day Of Month by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.dayOfMonth == 1) 
-                        currentDate.dayOfMonth = 31;
-                    else currentDate.dayOfMonth--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if ((termData < '0') || (termData > '3')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Day Of Month Value Manually
-                uint8_t tempMonthday = 0;
-                
-                // Convert ASCII input to raw number
-                tempMonthday = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempMonthday = tempMonthday + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.dayOfMonth = tempMonthday;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        case 'l': // Configure Month
-            usartStringSend(USART2, "Configure Month:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"01\" - \"12\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Month by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.month++;
-                    if (currentDate.month > 99) currentDate.month -= 100;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-
-            } else if (termData == '-'){ // Decrement Month by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.month = 1) currentDate.month = 12;
-                    else currentDate.month--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return; 
-
-            } else if ((termData < '0') || (termData > '1')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Year Value Manually
-                uint8_t tempMonth = 0;
-                
-                // Convert ASCII input to raw number
-                tempMonth = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempMonth = tempMonth + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.month = tempMonth;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        case 'y': // Configure Year
-            usartStringSend(USART2, "Configure Seconds:\r\n");
-            usartStringSend(USART2, "  Increment - +\r\n");
-            usartStringSend(USART2, "  Decrement - -\r\n");
-            usartStringSend(USART2, "  Set       - Input 2-Digit Number\r\n");
-            usartStringSend(USART2, "              (\"00\" - \"99\")\r\n");
-
-            termData = usartByteReceive(USART2);
-            if (termData == '+'){ // Increment Year by 1
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.year++;
-                    if (currentDate.year > 99) currentDate.year -= 100;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if (termData == '-'){ // Decrement Year by 1 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    if (currentDate.year = 0) currentDate.year = 99;
-                    else currentDate.year--;
-                    ds3231_writeDate(I2C1, &currentDate); 
-
-            } else if ((termData < '0') || (termData > '9')){
-                usartStringSend(USART2, "Invalid Input.\r\n");
-                usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                return;
-            
-            } else { // Set Year Value Manually
-                uint8_t tempYear = 0;
-                
-                // Convert ASCII input to raw number
-                tempYear = (termData - '0') * 10;
-                termData = usartByteReceive(USART2);
-
-                // Check if ASCII input is a valid number
-                if ((termData < '0') || (termData > '9')){
-                    usartStringSend(USART2, "Invalid Input.\r\n");
-                    usartStringSend(USART2, "Returning to Main Menu.\r\n");
-                    return;
-                } else {
-                    tempYear = tempYear + (termData - '0'); 
-
-                    // Data finally ready, send to clock. 
-                    ds3231Date currentDate;
-                    ds3231_readDate(I2C1, &currentDate);
-                    currentDate.year = tempYear;
-                    ds3231_writeDate(I2C1, &currentDate); 
-                    return;
-                }
-            
-            }
-            break;
-
-        default:
-            usartStringSend(USART2, "Invalid Input.\r\n");
-            usartStringSend(USART2, "Returning to Main Menu.\r\n");
+    for(addr = 0; addr < 0x80; addr++){
+        if(I2C_SCAN_FOUND(map, addr)) usartPrintf(USARTx, "0x%x\r\n", addr);
     }
+    return 1;
 }
 
-int main(void){
-    // Create storage info for current date/time.
-    ds3231Date currentDate;
-    uint8_t dateStringBuffer[8] = {'a', 'a', 'a', 'a', 'a', 'a', 'a', 0};
+static const consoleCommand consoleCommands[] = {
+    { "date", "", "Display the current date", 0, 0, cmdDate },
+    { "set", "<field> <n|+|->",
+        "Set hour/min/sec/dow/dom/month/year", 2, 2, cmdSet },
+    { "scan", "", "List devices on I2C1", 0, 0, cmdScan },
+};
+
+// Console input lands here by DMA, so keystrokes and pasted lines survive
+// while a command is blocked on I2C; a full scan takes about 112 ms.
+static uint8_t consoleRxBuffer[256];
 
+int main(void){
+    console con;
+    uint32_t heartbeat;
 
     // Initialize USART2 Clock to be connected to GPIO:
     // USART2_RX      -> PA_3
@@ -594,27 +198,39 @@ int main(void){
     // GPIO AF MODE   -> 5
     usartInit(USART2, GPIOA, 2, 3, 2, 3, 2, 7);
 
+    // Console output is queued and drained by interrupt, so printing never
+    // holds up the loop below.
+    usartTxBufferEnable(USART2, USART_TX_POLICY_BLOCK);
+
+    // No callback: consolePoll drains the buffer from the loop below, which
+    // keeps the commands out of interrupt context.
+    usartDmaRxEnable(USART2, consoleRxBuffer, sizeof(consoleRxBuffer), 0);
+
     // Initialize I2C1 to be connected to GPIO:
     // I2C1_SCL       -> PB_8
     // I2C1_SDA       -> PB_9
-    i2cInit(I2C1, GPIOB, 8, 9, 4);
+    if(!i2cInit(I2C1, GPIOB, 8, 9, 4)){
+        BINLOG(USART2, "I2C1 speed %u out of reach of PCLK1\n",
+                AMP_I2C_SPEED);
+    }
     Delay(400000);
 
     initHeartbeat();
     usartStringSend(USART2, "System Init Successful!\r\n");
-    usartStringSend(USART2, "Ready to accept commands! Or press h for Help!");
+    usartStringSend(USART2, "Ready to accept commands! Type help for Help!");
     usartStringSend(USART2, "\r\n\n\r");
 
-    for(;;){
-        // Heartbeat
-        GPIOA -> ODR ^= (1 << 5);
-
-        Delay(400000);
-        //ds3231_readDate(I2C1, &currentDate);
-        //printDateInfo(&currentDate);
-        checkDateChange();
+    consoleInit(&con, USART2, consoleCommands,
+            sizeof(consoleCommands) / sizeof(consoleCommands[0]), "> ");
 
-        Delay(1000);
+    heartbeat = timebaseCyclesGet();
+    for(;;){
+        // Heartbeat keeps its cadence whether or not anyone is typing.
+        if(timebaseExpired(heartbeat, HEARTBEAT_PERIOD_US)){
+            heartbeat = timebaseCyclesGet();
+            GPIOA -> ODR ^= (1 << 5);
+        }
 
+        consolePoll(&con);
     }
 }
@@ -42,42 +42,14 @@ void _ds3231_dateConvert_fromReadToRaw(ds3231Date* raw){
 
 
 
-void ds3231_readDate(I2C_TypeDef* I2Cx, ds3231Date* date){
+i2cStatus ds3231_readDate(I2C_TypeDef* I2Cx, ds3231Date* date){
     uint8_t buffer[7] = { 0, 0, 0, 0, 0, 0, 0};
-    uint8_t i;
+    i2cStatus status;
 
-    // Initiate and pull data from the DS3231 over I2C
-    i2cActivateAck(I2Cx);
-
-    i2cSendStart(I2Cx);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_MODE_ACTIVE_SR2));
-
-    i2cSendAddr7bit(I2Cx, DS3231_DEVICE_ADDRESS, 0);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR2));
-
-    i2cSendData(I2Cx, DS3231_SECONDS_REGISTER);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_BYTE_TRANSMITTED_SR1,
-                I2C_STATE_MASTER_BYTE_TRANSMITTED_SR2));
-
-    i2cSendStart(I2Cx);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_MODE_ACTIVE_SR2));
-
-    i2cSendAddr7bit(I2Cx, DS3231_DEVICE_ADDRESS, 1);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_RECEIVER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_RECEIVER_MODE_ACTIVE_SR2));
-
-    // Loop to receive 7 bytes, then send NACK-STOP to stop receiving data.
-    for(i=0; i < 7; i++){
-        while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_BYTE_RECEIVED_SR1,
-                    I2C_STATE_MASTER_BYTE_RECEIVED_SR2));
-        buffer[i] = i2cRecvData(I2Cx);
-    }
-
-    i2cDeactivateAck(I2Cx);
-    i2cSendStop(I2Cx);
+    // Pull all seven time registers from the DS3231 in one read
+    status = i2cMemRead(I2Cx, DS3231_DEVICE_ADDRESS, DS3231_SECONDS_REGISTER,
+            buffer, sizeof(buffer));
+    if(status != I2C_OK) return status;
 
     date->second       = buffer[0];
     date->minute       = buffer[1];
@@ -90,12 +62,11 @@ void ds3231_readDate(I2C_TypeDef* I2Cx, ds3231Date* date){
     // Send raw data through the converter.
     _ds3231_dateConvert_fromRawToRead(date);
 
-    return;
+    return I2C_OK;
 }
 
-void ds3231_writeDate(I2C_TypeDef* I2Cx, ds3231Date* date){
+i2cStatus ds3231_writeDate(I2C_TypeDef* I2Cx, ds3231Date* date){
     uint8_t buffer[7];
-    uint8_t i;
 
     _ds3231_dateConvert_fromReadToRaw(date);
     buffer[0] = date->second;
@@ -106,27 +77,6 @@ void ds3231_writeDate(I2C_TypeDef* I2Cx, ds3231Date* date){
     buffer[5] = date->month;
     buffer[6] = date->year;
 
-    i2cActivateAck(I2Cx);
-
-    i2cSendStart(I2Cx);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_MODE_ACTIVE_SR2));
-
-    i2cSendAddr7bit(I2Cx, DS3231_DEVICE_ADDRESS, 0);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR1,
-                I2C_STATE_MASTER_TRANSMITTER_MODE_ACTIVE_SR2));
-
-    i2cSendData(I2Cx, DS3231_SECONDS_REGISTER);
-    while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_BYTE_TRANSMITTED_SR1,
-                I2C_STATE_MASTER_BYTE_TRANSMITTED_SR2));
-
-    for(i = 0; i < 7; i++){
-        i2cSendData(I2Cx, buffer[i]);
-        while ( !i2cStateCheck(I2Cx, I2C_STATE_MASTER_BYTE_TRANSMITTED_SR1,
-                    I2C_STATE_MASTER_BYTE_TRANSMITTED_SR2));
-    }
-
-    i2cSendStop(I2Cx);
-    i2cDeactivateAck(I2Cx);
+    return i2cMemWrite(I2Cx, DS3231_DEVICE_ADDRESS, DS3231_SECONDS_REGISTER,
+            buffer, sizeof(buffer));
 }
-
@@ -0,0 +1,66 @@
+/**
+ * @file rcc.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief RCC Clock Query Code for stm32f4xx
+ *
+ * This file contains private and public functions for reading back the clock
+ * tree of an stm32f4xx microcontroller. Comes as part of the
+ * stm32f4xx-amperture-periphlib package. Nothing here changes the clock
+ * configuration; SystemInit or the application owns that.
+ *
+ * @see http://www.st.com/web/en/resource/technical/document/reference_manual/DM00096844.pdf
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include "rcc.h"
+
+// Private Variables
+
+// Right shift applied to HCLK for each HPRE value, RM0368 section 6.3.3.
+// Note that /32 does not exist, 0b1100 is /64.
+static const uint8_t _rccAhbShift[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9
+};
+
+// Right shift applied to PCLKx for each PPRE1/PPRE2 value.
+static const uint8_t _rccApbShift[8] = { 0, 0, 0, 0, 1, 2, 3, 4 };
+
+//// Public Functions
+
+uint32_t rccSysclkGet(void){
+    uint32_t pllcfgr, pllIn, pllm, plln, pllp;
+
+    switch(RCC -> CFGR & RCC_CFGR_SWS){
+        case RCC_CFGR_SWS_HSE:
+            return HSE_VALUE;
+
+        case RCC_CFGR_SWS_PLL:
+            pllcfgr = RCC -> PLLCFGR;
+            pllIn = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? HSE_VALUE : HSI_VALUE;
+            pllm = pllcfgr & RCC_PLLCFGR_PLLM;
+            plln = (pllcfgr & RCC_PLLCFGR_PLLN) >> 6;
+            pllp = ((((pllcfgr & RCC_PLLCFGR_PLLP) >> 16) + 1) * 2);
+            if(pllm == 0) return HSI_VALUE;
+
+            // VCO input is 1-2 MHz so the product always fits 32 bits.
+            return ((pllIn / pllm) * plln) / pllp;
+
+        default:
+            return HSI_VALUE;
+    }
+}
+
+uint32_t rccHclkGet(void){
+    return rccSysclkGet() >> _rccAhbShift[(RCC -> CFGR & RCC_CFGR_HPRE) >> 4];
+}
+
+uint32_t rccPclk1Get(void){
+    return rccHclkGet() >> _rccApbShift[(RCC -> CFGR & RCC_CFGR_PPRE1) >> 10];
+}
+
+uint32_t rccPclk2Get(void){
+    return rccHclkGet() >> _rccApbShift[(RCC -> CFGR & RCC_CFGR_PPRE2) >> 13];
+}
@@ -0,0 +1,60 @@
+/**
+ * @file timebase.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Timebase Code for stm32f4xx
+ *
+ * This file contains private and public functions for measuring time with
+ * the Cortex-M4 DWT cycle counter. Comes as part of the
+ * stm32f4xx-amperture-periphlib package. Used by the other drivers so that
+ * every wait has a real, clock-independent bound.
+ *
+ * @see http://infocenter.arm.com/help/topic/com.arm.doc.ddi0439b/BEIFGAGA.html
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include "timebase.h"
+#include "rcc.h"
+
+// Private Variables
+
+static uint32_t _timebaseCyclesPerUs = 0;
+
+//// Public Functions
+
+void timebaseInit(void){
+    uint32_t hclk = rccHclkGet();
+
+    // Trace must be enabled for the DWT unit to count.
+    CoreDebug -> DEMCR  |=  CoreDebug_DEMCR_TRCENA_Msk;
+    DWT -> CTRL         |=  DWT_CTRL_CYCCNTENA_Msk;
+
+    _timebaseCyclesPerUs = hclk / 1000000;
+    if(_timebaseCyclesPerUs == 0) _timebaseCyclesPerUs = 1;
+}
+
+uint32_t timebaseCyclesGet(void){
+    if(_timebaseCyclesPerUs == 0) timebaseInit();
+    return DWT -> CYCCNT;
+}
+
+uint8_t timebaseExpired(uint32_t start, uint32_t timeoutUs){
+    if(timeoutUs == TIMEBASE_WAIT_FOREVER) return 0;
+    if(_timebaseCyclesPerUs == 0) timebaseInit();
+
+    // Unsigned subtraction handles a single counter wrap.
+    return (uint64_t)(DWT -> CYCCNT - start)
+        >= ((uint64_t)timeoutUs * _timebaseCyclesPerUs);
+}
+
+uint32_t timebaseCyclesToUs(uint32_t cycles){
+    if(_timebaseCyclesPerUs == 0) timebaseInit();
+    return cycles / _timebaseCyclesPerUs;
+}
+
+void timebaseDelayUs(uint32_t us){
+    uint32_t start = timebaseCyclesGet();
+    while(!timebaseExpired(start, us));
+}
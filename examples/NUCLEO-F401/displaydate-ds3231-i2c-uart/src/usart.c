@@ -7,8 +7,11 @@
  *
  * This file contains private and public functions for using the USART 
  * peripherals on an stm32f4xx microcontroller. Comes as part of the 
- * stm32f4xx-amperture-periphlib package. At current does not support 
- * interrupts or DMA.
+ * stm32f4xx-amperture-periphlib package. Transmit can optionally be buffered
+ * in a ring and fed from the TXE/TC interrupts, see usartTxBufferEnable(),
+ * or sent by DMA straight from caller-owned blocks, see usartDmaTxEnable().
+ * Receive can run as circular DMA with IDLE line framing, see
+ * usartDmaRxEnable().
  *
  * This driver package at current is not meant to be simply included without
  * review into a project. It is fully expected that the programmer will 
@@ -20,39 +23,604 @@
 
 #include <stm32f4xx.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
 #include <usart.h>
+#include <rcc.h>
+#include <timebase.h>
+
+// Private Types
+
+typedef struct usartDmaBlock {
+    const uint8_t*      data;
+    uint16_t            len;
+} usartDmaBlock;
+
+// Fixed hardware description of one USART, lives in flash.
+typedef struct usartPortConfig {
+    USART_TypeDef*      USARTx;
+    IRQn_Type           irq;
+    uint8_t             apb2;           // 1 if clocked from PCLK2.
+    volatile uint32_t*  rccEnr;         // RCC APBxENR register ...
+    uint32_t            rccEnBit;       // ... and the enable bit within it.
+
+    DMA_TypeDef*        txDma;
+    DMA_Stream_TypeDef* txStream;
+    uint8_t             txStreamNum;
+    uint8_t             txChannel;
+    IRQn_Type           txDmaIrq;
+
+    DMA_TypeDef*        rxDma;
+    DMA_Stream_TypeDef* rxStream;
+    uint8_t             rxStreamNum;
+    uint8_t             rxChannel;
+    IRQn_Type           rxDmaIrq;
+} usartPortConfig;
+
+// Run-time state of one USART, lives in RAM.
+typedef struct usartPort {
+    const usartPortConfig*  cfg;
+
+    uint8_t             txBuffered;
+    usartTxPolicy       txPolicy;
+    volatile uint16_t   txHead;     // Written by the caller only.
+    volatile uint16_t   txTail;     // Written by the ISR only, barring drains.
+    uint8_t             txBuffer[AMP_USART_TX_BUFFER_SIZE];
+
+    uint8_t             txDmaEnabled;
+    usartDmaTxCallback  txDmaCallback;
+    volatile uint8_t    txDmaCount;     // Blocks queued, including in flight.
+    volatile uint8_t    txDmaSlot;      // Slot currently in flight.
+    usartDmaBlock       txDmaBlocks[2];
+
+    uint8_t             rxDmaEnabled;
+    usartRxCallback     rxCallback;
+    usartRxByteCallback rxByteCallback; // Per-character Rx interrupt.
+    uint8_t*            rxBuffer;
+    uint16_t            rxSize;
+    volatile uint16_t   rxRead;         // Oldest unconsumed byte.
+    volatile uint16_t   rxErrors;       // Sticky USART_SR error bits.
+
+    uint8_t             rxFlowRts;      // RTS follows the DMA buffer fill.
+    volatile uint8_t    rxFlowStopped;  // DMAR is held off, RTS deasserted.
+    uint16_t            rxDmaSeen;      // DMA head at the last byte count.
+
+    GPIO_TypeDef*       deGPIO;         // RS-485 driver enable, 0 if unused.
+    uint16_t            deMask;         // DE pin as a bit mask.
+    uint8_t             deActiveLow;
+
+    usartStats          stats;
+} usartPort;
+
+// Private Variables
+
+// USART1, USART2 and USART6 are the ports present on the stm32f401. To
+// support a larger part add a row here; the DMA streams must not overlap.
+// DMA mapping per RM0368 Table 28/29.
+static const usartPortConfig _usartPortConfigs[] = {
+    {
+        .USARTx = USART1, .irq = USART1_IRQn, .apb2 = 1,
+        .rccEnr = &(RCC -> APB2ENR), .rccEnBit = RCC_APB2ENR_USART1EN,
+        .txDma = DMA2, .txStream = DMA2_Stream7, .txStreamNum = 7,
+        .txChannel = 4, .txDmaIrq = DMA2_Stream7_IRQn,
+        .rxDma = DMA2, .rxStream = DMA2_Stream2, .rxStreamNum = 2,
+        .rxChannel = 4, .rxDmaIrq = DMA2_Stream2_IRQn,
+    },
+    {
+        .USARTx = USART2, .irq = USART2_IRQn, .apb2 = 0,
+        .rccEnr = &(RCC -> APB1ENR), .rccEnBit = RCC_APB1ENR_USART2EN,
+        .txDma = DMA1, .txStream = DMA1_Stream6, .txStreamNum = 6,
+        .txChannel = 4, .txDmaIrq = DMA1_Stream6_IRQn,
+        .rxDma = DMA1, .rxStream = DMA1_Stream5, .rxStreamNum = 5,
+        .rxChannel = 4, .rxDmaIrq = DMA1_Stream5_IRQn,
+    },
+    {
+        .USARTx = USART6, .irq = USART6_IRQn, .apb2 = 1,
+        .rccEnr = &(RCC -> APB2ENR), .rccEnBit = RCC_APB2ENR_USART6EN,
+        .txDma = DMA2, .txStream = DMA2_Stream6, .txStreamNum = 6,
+        .txChannel = 5, .txDmaIrq = DMA2_Stream6_IRQn,
+        .rxDma = DMA2, .rxStream = DMA2_Stream1, .rxStreamNum = 1,
+        .rxChannel = 5, .rxDmaIrq = DMA2_Stream1_IRQn,
+    },
+};
+
+#define AMP_USART_PORT_COUNT \
+    (sizeof(_usartPortConfigs) / sizeof(_usartPortConfigs[0]))
+
+static usartPort _usartPorts[AMP_USART_PORT_COUNT];
+
+// "00" to "99", so decimal conversion takes one divide per two digits.
+static const char _usartDigitPairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8',
+    '0','9','1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7',
+    '1','8','1','9','2','0','2','1','2','2','2','3','2','4','2','5','2','6',
+    '2','7','2','8','2','9','3','0','3','1','3','2','3','3','3','4','3','5',
+    '3','6','3','7','3','8','3','9','4','0','4','1','4','2','4','3','4','4',
+    '4','5','4','6','4','7','4','8','4','9','5','0','5','1','5','2','5','3',
+    '5','4','5','5','5','6','5','7','5','8','5','9','6','0','6','1','6','2',
+    '6','3','6','4','6','5','6','6','6','7','6','8','6','9','7','0','7','1',
+    '7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9','8','0',
+    '8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8',
+    '9','9'
+};
+
+static const char _usartHexLower[16] = {
+    '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'
+};
+
+static const char _usartHexUpper[16] = {
+    '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F'
+};
+
+// Bit offset of each stream's flags within DMA_LISR/HISR and LIFCR/HIFCR.
+static const uint8_t _usartDmaFlagShift[4] = { 0, 6, 16, 22 };
+
+// FEIF, DMEIF, TEIF, HTIF, TCIF
+#define AMP_USART_DMA_FLAGS_ALL ((uint32_t)0x3D)
+#define AMP_USART_DMA_FLAG_TE   ((uint32_t)0x08)
+#define AMP_USART_DMA_FLAG_HT   ((uint32_t)0x10)
+#define AMP_USART_DMA_FLAG_TC   ((uint32_t)0x20)
+
+// Characters staged on the stack by usartPrintf before each bulk copy.
+#define AMP_USART_FMT_CHUNK     32
+
+#define AMP_USART_SR_ERRORS     (USART_SR_ORE | USART_SR_FE | USART_SR_NE \
+                                | USART_SR_PE)
+
+//// Private Functions
+
+static usartPort* _usartPortGet(USART_TypeDef* USARTx){
+    uint8_t i;
+    for(i = 0; i < AMP_USART_PORT_COUNT; i++){
+        if(_usartPortConfigs[i].USARTx == USARTx){
+            // State blocks are bound to their config on first use.
+            _usartPorts[i].cfg = &_usartPortConfigs[i];
+            return &_usartPorts[i];
+        }
+    }
+    return 0;
+}
+
+static uint32_t _usartCriticalEnter(void){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void _usartCriticalExit(uint32_t primask){
+    __set_PRIMASK(primask);
+}
+
+// Nonzero when the USART interrupt cannot run to drain the ring for us,
+// either because interrupts are masked or we are already inside a handler.
+static uint8_t _usartIrqBlocked(void){
+    return (__get_PRIMASK() != 0) || (__get_IPSR() != 0);
+}
+
+// Latches receive errors for usartRxErrors and counts each kind.
+static void _usartRxErrorsRecord(usartPort* port, uint32_t sr){
+    sr &= AMP_USART_SR_ERRORS;
+    if(sr == 0) return;
+
+    port -> rxErrors |= sr;
+    if(sr & USART_SR_ORE) port -> stats.overrunErrors++;
+    if(sr & USART_SR_FE) port -> stats.framingErrors++;
+    if(sr & USART_SR_NE) port -> stats.noiseErrors++;
+    if(sr & USART_SR_PE) port -> stats.parityErrors++;
+}
+
+// Spins until a status flag sets, charging the time to *cycles. The cycle
+// counter is only read when there is actually something to wait for.
+static void _usartFlagWait(USART_TypeDef* USARTx, uint32_t flag,
+        uint32_t* cycles){
+    uint32_t start;
+
+    if(USARTx -> SR & flag) return;
+    start = timebaseCyclesGet();
+    while( !(USARTx -> SR & flag));
+    if(cycles) *cycles += timebaseCyclesGet() - start;
+}
+
+// RS-485: drive DE before the first bit goes out and arm TC to drop it once
+// the stop bit of the last byte has left. Call with interrupts masked or
+// from an interrupt.
+static void _usartDeAssert(usartPort* port){
+    if(port -> deGPIO == 0) return;
+
+    if(port -> deActiveLow) port -> deGPIO -> BSRRH = port -> deMask;
+    else port -> deGPIO -> BSRRL = port -> deMask;
+    port -> cfg -> USARTx -> CR1 |= USART_CR1_TCIE;
+}
+
+static void _usartDeRelease(usartPort* port){
+    if(port -> deGPIO == 0) return;
+
+    if(port -> deActiveLow) port -> deGPIO -> BSRRL = port -> deMask;
+    else port -> deGPIO -> BSRRH = port -> deMask;
+}
+
+// Blocking single character send. DE and the DR write happen together so
+// a TC interrupt from the previous character can't drop DE in between.
+// The caller has already seen TXE, which also arms the TC clear sequence.
+static void _usartTxByte(usartPort* port, uint16_t data){
+    uint32_t primask = _usartCriticalEnter();
+
+    _usartDeAssert(port);
+    port -> cfg -> USARTx -> DR = data;
+    _usartCriticalExit(primask);
+}
+
+// Pushes the oldest queued byte out by polling. Only used when the ISR
+// is unable to make progress, so the caller never deadlocks on a full ring.
+static void _usartTxDrainOne(usartPort* port){
+    uint32_t primask = _usartCriticalEnter();
+    uint16_t tail = port -> txTail;
+
+    if(tail != port -> txHead){
+        _usartFlagWait(port -> cfg -> USARTx, USART_SR_TXE,
+                &(port -> stats.txWaitCycles));
+        _usartDeAssert(port);
+        port -> cfg -> USARTx -> DR = port -> txBuffer[tail];
+        port -> txTail = (tail + 1) & AMP_USART_TX_BUFFER_MASK;
+        port -> stats.txBytes++;
+    }
+    _usartCriticalExit(primask);
+}
+
+// Retires a finished DMA block by polling the stream flags. Only does
+// anything when the DMA interrupt is unable to run, so a caller waiting on
+// txDmaCount never deadlocks.
+static void _usartDmaTxPoll(usartPort* port){
+    uint32_t primask;
+
+    if(!_usartIrqBlocked()) return;
+    primask = _usartCriticalEnter();
+    usartDmaTxIRQHandler(port -> cfg -> USARTx);
+    _usartCriticalExit(primask);
+}
+
+// Waits for every queued DMA block to finish.
+static void _usartDmaTxWait(usartPort* port){
+    while(port -> txDmaCount) _usartDmaTxPoll(port);
+}
+
+static void _usartTxPush(usartPort* port, uint8_t data){
+    uint16_t head = port -> txHead;
+    uint16_t next = (head + 1) & AMP_USART_TX_BUFFER_MASK;
+    uint16_t used;
+    uint32_t primask, start = 0;
+
+    // Ring is full, apply the configured policy.
+    while(next == port -> txTail){
+        if(port -> txPolicy == USART_TX_POLICY_DROP){
+            port -> stats.txDropped++;
+            return;
+        }
+
+        if(port -> txPolicy == USART_TX_POLICY_OVERWRITE){
+            primask = _usartCriticalEnter();
+            if(next == port -> txTail){
+                port -> txTail = (next + 1) & AMP_USART_TX_BUFFER_MASK;
+                port -> stats.txDropped++;
+            }
+            _usartCriticalExit(primask);
+        } else if(_usartIrqBlocked()){
+            _usartTxDrainOne(port);
+        } else if(start == 0){
+            // USART_TX_POLICY_BLOCK: the TXE interrupt frees a slot.
+            start = timebaseCyclesGet() | 1;
+        }
+    }
+    if(start) port -> stats.txWaitCycles += timebaseCyclesGet() - start;
+
+    port -> txBuffer[head] = data;
+    port -> txHead = next;
+
+    used = (next - port -> txTail) & AMP_USART_TX_BUFFER_MASK;
+    if(used > port -> stats.txPeak) port -> stats.txPeak = used;
+
+    // Kick the TXE interrupt, the ISR turns it back off once the ring drains.
+    primask = _usartCriticalEnter();
+    _usartDeAssert(port);
+    port -> cfg -> USARTx -> CR1 |= USART_CR1_TXEIE;
+    _usartCriticalExit(primask);
+}
+
+static uint32_t _usartDmaFlagsGet(DMA_TypeDef* DMAx, uint8_t streamNum){
+    uint32_t isr = (streamNum > 3) ? DMAx -> HISR : DMAx -> LISR;
+    return (isr >> _usartDmaFlagShift[streamNum & 0x03])
+        & AMP_USART_DMA_FLAGS_ALL;
+}
+
+static void _usartDmaFlagsClear(DMA_TypeDef* DMAx, uint8_t streamNum,
+        uint32_t flags){
+    flags <<= _usartDmaFlagShift[streamNum & 0x03];
+    if(streamNum > 3) DMAx -> HIFCR = flags;
+    else DMAx -> LIFCR = flags;
+}
+
+static void _usartDmaClockEnable(DMA_TypeDef* DMAx){
+    if(DMAx == DMA1) RCC -> AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    else RCC -> AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+}
+
+// Loads a queued block into the Tx stream and starts it.
+static void _usartDmaTxStart(usartPort* port, uint8_t slot){
+    DMA_Stream_TypeDef* stream = port -> cfg -> txStream;
+
+    _usartDmaFlagsClear(port -> cfg -> txDma, port -> cfg -> txStreamNum,
+            AMP_USART_DMA_FLAGS_ALL);
+    stream -> M0AR  =   (uint32_t)(port -> txDmaBlocks[slot].data);
+    stream -> NDTR  =   port -> txDmaBlocks[slot].len;
+
+    port -> txDmaSlot = slot;
+    // TC, RXNE, LBD and CTS are rc_w0: write 1 to the ones to keep, so a
+    // flag set between a read and the write back can't be lost.
+    port -> cfg -> USARTx -> SR = (uint16_t)~(USART_SR_TC);
+    _usartDeAssert(port);
+    stream -> CR    |=  DMA_SxCR_EN;
+}
+
+// Copies as much of buf into the ring as fits before the timeout, in at most
+// two memcpy calls per pass, and kicks TXE once per chunk.
+static uint16_t _usartTxWrite(usartPort* port, const uint8_t* buf,
+        uint16_t len, uint32_t start, uint32_t timeoutUs){
+    uint16_t sent = 0;
+    uint16_t head, space, chunk;
+    uint32_t primask;
+
+    while(sent < len){
+        head = port -> txHead;
+        space = (port -> txTail - head - 1) & AMP_USART_TX_BUFFER_MASK;
+
+        if(space == 0){
+            if(timebaseExpired(start, timeoutUs)) break;
+            if(_usartIrqBlocked()) _usartTxDrainOne(port);
+            continue;
+        }
+
+        chunk = AMP_USART_TX_BUFFER_SIZE - head;
+        if(chunk > space) chunk = space;
+        if(chunk > (len - sent)) chunk = len - sent;
+
+        memcpy(&(port -> txBuffer[head]), &buf[sent], chunk);
+        port -> txHead = (head + chunk) & AMP_USART_TX_BUFFER_MASK;
+        sent += chunk;
+
+        space = (port -> txHead - port -> txTail) & AMP_USART_TX_BUFFER_MASK;
+        if(space > port -> stats.txPeak) port -> stats.txPeak = space;
+
+        primask = _usartCriticalEnter();
+        _usartDeAssert(port);
+        port -> cfg -> USARTx -> CR1 |= USART_CR1_TXEIE;
+        _usartCriticalExit(primask);
+    }
+    return sent;
+}
+
+// Current DMA write position inside the circular receive buffer.
+static uint16_t _usartDmaRxHead(usartPort* port){
+    uint16_t head = port -> rxSize
+        - (uint16_t)(port -> cfg -> rxStream -> NDTR);
+
+    // NDTR reads 0 for an instant before the circular reload.
+    if(head >= port -> rxSize) head = 0;
+    return head;
+}
+
+// Bytes received by the DMA but not yet consumed.
+static uint16_t _usartDmaRxPending(usartPort* port){
+    uint16_t pending = _usartDmaRxHead(port) + port -> rxSize - port -> rxRead;
+    if(pending >= port -> rxSize) pending -= port -> rxSize;
+    return pending;
+}
+
+// Counts the bytes the DMA has written since the last call and tracks the
+// fill peak. Called on every HT/TC/IDLE event, so it never misses a lap.
+static void _usartDmaRxTrack(usartPort* port){
+    uint16_t head = _usartDmaRxHead(port);
+    uint16_t pending = _usartDmaRxPending(port);
+
+    port -> stats.rxBytes += ((uint32_t)head + port -> rxSize
+            - port -> rxDmaSeen) % port -> rxSize;
+    port -> rxDmaSeen = head;
+    if(pending > port -> stats.rxPeak) port -> stats.rxPeak = pending;
+}
+
+// RTS with circular DMA: the DMA empties DR immediately, so the hardware
+// would never deassert RTS on its own. Pausing the DMA request leaves the
+// next byte in DR, which drops RTS until the buffer has been drained.
+// Checks run on every HT/TC/IDLE event, at most half a buffer apart, so a
+// high mark of half the buffer can't be lapped. Call with interrupts masked
+// or from the USART/DMA interrupt.
+static void _usartRxFlowUpdate(usartPort* port){
+    USART_TypeDef* USARTx = port -> cfg -> USARTx;
+    uint16_t pending;
+
+    if(!(port -> rxFlowRts) || !(port -> rxDmaEnabled)) return;
+    pending = _usartDmaRxPending(port);
+
+    if(!(port -> rxFlowStopped) && (pending >= (port -> rxSize / 2))){
+        // IDLE can only be cleared by reading DR, which would eat the byte
+        // being held back, so it waits until reception resumes.
+        USARTx -> CR1   &=  ~(USART_CR1_IDLEIE);
+        USARTx -> CR3   &=  ~(USART_CR3_DMAR);
+        port -> rxFlowStopped = 1;
+    } else if(port -> rxFlowStopped && (pending <= (port -> rxSize / 4))){
+        USARTx -> CR3   |=  USART_CR3_DMAR;
+        USARTx -> CR1   |=  USART_CR1_IDLEIE;
+        port -> rxFlowStopped = 0;
+    }
+}
+
+// Hands everything between the read index and the DMA write position to the
+// callback, at most two contiguous pieces when the data wraps.
+static void _usartDmaRxDeliver(usartPort* port){
+    uint16_t head = _usartDmaRxHead(port);
+    uint16_t read = port -> rxRead;
+    uint16_t len, used;
+
+    if(port -> rxCallback == 0) return;
+
+    while(read != head){
+        len = ((head > read) ? head : port -> rxSize) - read;
+        used = port -> rxCallback(port -> cfg -> USARTx,
+                &(port -> rxBuffer[read]), len);
+        if(used > len) used = len;
+
+        read += used;
+        if(read >= port -> rxSize) read = 0;
+        if(used < len) break;
+    }
+    port -> rxRead = read;
+}
+
+static uint32_t _usartClockGet(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    return ((port != 0) && port -> cfg -> apb2) ? rccPclk2Get() : rccPclk1Get();
+}
+
+// Picks the oversampling mode and writes OVER8 and BRR. UE is left alone.
+static uint8_t _usartBaudConfigure(USART_TypeDef* USARTx, uint32_t baud,
+        int32_t* errorPpm){
+    uint32_t fclk = _usartClockGet(USARTx);
+    int32_t err16 = 0, err8 = 0;
+    uint16_t brr16 = usartBaudDivisorCompute(fclk, baud, 0, &err16);
+    uint16_t brr8 = usartBaudDivisorCompute(fclk, baud, 1, &err8);
+    uint8_t over8;
+
+    if((brr16 == 0) && (brr8 == 0)) return 0;
+
+    // Stay on 16x unless 8x is the only option or at least halves the error.
+    over8 = (brr16 == 0) || ((brr8 != 0) &&
+            (2 * (err8 < 0 ? -err8 : err8) < (err16 < 0 ? -err16 : err16)));
+
+    if(over8){
+        USARTx -> CR1   |=  USART_CR1_OVER8;
+        USARTx -> BRR   =   brr8;
+    } else {
+        USARTx -> CR1   &=  ~(USART_CR1_OVER8);
+        USARTx -> BRR   =   brr16;
+    }
+
+    if(errorPpm) *errorPpm = over8 ? err8 : err16;
+    return 1;
+}
+
+// Pull-mode read out of the circular DMA buffer, used when no callback is set.
+static uint16_t _usartDmaRxCopy(usartPort* port, uint8_t* buf, uint16_t len){
+    uint16_t head = _usartDmaRxHead(port);
+    uint16_t read = port -> rxRead;
+    uint16_t got = 0;
+    uint16_t chunk;
+
+    while((read != head) && (got < len)){
+        chunk = ((head > read) ? head : port -> rxSize) - read;
+        if(chunk > (len - got)) chunk = len - got;
+
+        memcpy(&buf[got], &(port -> rxBuffer[read]), chunk);
+        got += chunk;
+        read += chunk;
+        if(read >= port -> rxSize) read = 0;
+    }
+    port -> rxRead = read;
+    return got;
+}
+
+// Staging state for usartPrintf.
+typedef struct usartFmtOut {
+    USART_TypeDef*  USARTx;
+    usartPort*      port;
+    uint16_t        count;
+    uint8_t         fill;
+    uint8_t         buf[AMP_USART_FMT_CHUNK];
+} usartFmtOut;
+
+static void _usartFmtFlush(usartFmtOut* out){
+    uint8_t i;
+
+    if(out -> fill == 0) return;
+
+    // Blocking ports and the BLOCK policy take the bulk path; DROP and
+    // OVERWRITE go byte by byte so their policy is applied to each byte.
+    if((out -> port != 0) && out -> port -> txBuffered
+            && (out -> port -> txPolicy != USART_TX_POLICY_BLOCK)){
+        for(i = 0; i < out -> fill; i++){
+            _usartTxPush(out -> port, out -> buf[i]);
+        }
+    } else {
+        usartWrite(out -> USARTx, out -> buf, out -> fill,
+                TIMEBASE_WAIT_FOREVER, 0);
+    }
+    out -> fill = 0;
+}
+
+static void _usartFmtPut(usartFmtOut* out, uint8_t c){
+    if(out -> fill == AMP_USART_FMT_CHUNK) _usartFmtFlush(out);
+    out -> buf[out -> fill++] = c;
+    out -> count++;
+}
+
+static void _usartFmtPad(usartFmtOut* out, uint8_t c, int16_t n){
+    while(n-- > 0) _usartFmtPut(out, c);
+}
+
+// Writes v in decimal to the end of tmp[10], returns the digit count.
+static uint8_t _usartFmtDec(char* tmp, uint32_t v){
+    uint8_t i = 10;
+    uint32_t q;
+
+    while(v >= 100){
+        q = v / 100;
+        i -= 2;
+        memcpy(&tmp[i], &_usartDigitPairs[(v - (q * 100)) * 2], 2);
+        v = q;
+    }
+    if(v >= 10){
+        i -= 2;
+        memcpy(&tmp[i], &_usartDigitPairs[v * 2], 2);
+    } else {
+        tmp[--i] = '0' + v;
+    }
+    return 10 - i;
+}
+
+// Writes v in hex to the end of tmp[10], returns the digit count.
+static uint8_t _usartFmtHex(char* tmp, uint32_t v, const char* digits){
+    uint8_t i = 10;
+
+    do {
+        tmp[--i] = digits[v & 0x0F];
+        v >>= 4;
+    } while(v);
+    return 10 - i;
+}
+
+//// Public Functions
 
-/** USART Init
- * @brief Init function for USART peripheral.
- * @param *USARTx: Which USART internal peripheral to use.
- * @param *GPIOx: Which GPIO Port to use.
- * @param txPin: GPIO Pin to use for Tx, send as integer, NOT Bitmask.
- * @param rxPin: GPIO Pin to use for Rx, send as integer, NOT Bitmask.
- * @param ctsPin: GPIO Pin to use for CTS, send as integer, NOT Bitmask.
- * @param rtsPin: GPIO Pin to use for RTS, send as integer, NOT Bitmask.
- * @param ckPin: GPIO Pin to use for CK, send as integer, NOT Bitmask.
- * @param afMode: Alternate Function mode for GPIO pins, refer to datasheet.
- * @retval void
- * @see http://www.st.com/st-web-ui/static/active/en/resource/technical/document/datasheet/DM00102166.pdf
- */
 void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
         uint8_t rxPin, uint8_t ctsPin, uint8_t rtsPin, uint8_t ckPin,
         uint8_t afMode){
 
-    // Enable the USART clock in the RCC register.
-    // Uncommment only two lines, one for USART, one for GPIO.
-    //RCC -> APB2ENR |= RCC_APB2ENR_USART1EN;
-    RCC -> APB1ENR |= RCC_APB1ENR_USART2EN;
-    //RCC -> APB1ENR |= RCC_APB1ENR_USART3EN;
-    //RCC -> APB1ENR |= RCC_APB1ENR_UART4EN;
-    //RCC -> APB1ENR |= RCC_APB1ENR_UART5EN;
-    //RCC -> APB2ENR |= RCC_APB2ENR_USART6EN;
-    //RCC -> APB1ENR |= RCC_APB1ENR_UART7EN;
-    //RCC -> APB1ENR |= RCC_APB1ENR_UART8EN;
-
-    // Enable RCC AHB Register for GPIO
-    // Please replace RCC_AHB1ENR_GPIOxEN, x = (A, B, C, ..., I)
-    RCC -> AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+    usartPort* port = _usartPortGet(USARTx);
+
+    // Enable the USART clock from the port table, and the GPIO port clock
+    // from its position on AHB1 (GPIOA, GPIOB, ... are 0x400 apart).
+    if(port != 0){
+        *(port -> cfg -> rccEnr) |= port -> cfg -> rccEnBit;
+
+        // Re-init: stop any DMA left running by a previous configuration.
+        if(port -> rxDmaEnabled) usartDmaRxDisable(USARTx);
+        if(port -> txDmaEnabled){
+            port -> cfg -> txStream -> CR &= ~(DMA_SxCR_EN);
+        }
+
+        // Start from a clean state block; CR1 below drops all interrupts.
+        memset(port, 0, sizeof(*port));
+        port -> cfg = &_usartPortConfigs[port - _usartPorts];
+    }
+    RCC -> AHB1ENR |= (1UL << (((uint32_t)GPIOx - GPIOA_BASE) >> 10));
 
     // Disable Internal USART Peripheral Clock.
     USARTx -> CR1   &=  ~( USART_CR1_UE );
@@ -63,7 +631,7 @@ void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
                                             // TODO: Research SBK Further
 
                         // | USART_CR1_RWU     // Receiver Wakeup
-                                            // TODO: Research Further
+                                            // See usartMute
                                             
                         | USART_CR1_RE      // Receiver Enable
                         | USART_CR1_TE      // Transmitter Enable
@@ -80,6 +648,7 @@ void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
 
                         // | USART_CR1_WAKE    // Wake method,0=IdleLine,1=AddrMk
                         // | USART_CR1_M       // Word Length,0=8DataBits,1=9Data
+                                            // See usartMultiprocessorEnable
 
                         // | USART_CR1_OVER8   // Oversampling Mode, 0=16, 1=8
                                             // TODO: Research Further
@@ -87,8 +656,9 @@ void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
 
     /*
     USARTx -> CR2   |=  (0
-                        | USART_CR2_LINEN   // LIN Enable TODO: Research
-                        | USART_CR2_ADD     // Address of Node TODO:4-Bit
+                        | USART_CR2_LINEN   // LIN Enable, see usartLinEnable
+                        | USART_CR2_ADD     // Address of Node, 4-Bit
+                                            // See usartMultiprocessorEnable
 
                                             // TODO: Research LIN
                         | USART_CR2_LBDIE   // LIN Break Int Enable
@@ -129,7 +699,8 @@ void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
                         );
     */
 
-    USARTx -> BRR   =   AMP_USART_FCLK_SPEED / AMP_USART_BAUD_RATE;
+    // Baud rate from the live APB clock rather than a compile-time guess.
+    _usartBaudConfigure(USARTx, AMP_USART_BAUD_RATE, 0);
 
     // Re-enable the peripheral
     USARTx -> CR1   |=  USART_CR1_UE;
@@ -162,35 +733,976 @@ void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
     else GPIOx -> AFR[0] |= (afMode << (4 * rtsPin));
 }
 
-/** USART Receive Single Byte
- * @brief Pulls a single byte over the configured USART peripheral.
- * @param *USARTx: Which USART peripheral to send data over.
- * @retval 8-bit data pulled from USART.
- */
 uint8_t usartByteReceive(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
     uint8_t data = 0;
-    while( !((USARTx -> SR) & USART_SR_RXNE));
+
+    if(port == 0){
+        while( !((USARTx -> SR) & USART_SR_RXNE));
+        return USARTx -> DR;
+    }
+
+    _usartFlagWait(USARTx, USART_SR_RXNE, &(port -> stats.rxWaitCycles));
+    _usartRxErrorsRecord(port, USARTx -> SR);
     data = USARTx -> DR;
+    port -> stats.rxBytes++;
     return data;
 }
 
-/** USART Send Single Byte
- * @brief Sends a single byte over the configured USART peripheral.
- * @param *USARTx: Which USART peripheral to send data over.
- * @param data: Byte to send.
- */
 void usartByteSend(USART_TypeDef* USARTx, uint8_t data){
-    while( !(USARTx -> SR & USART_SR_TXE));
-    USARTx -> DR = data;
+    usartPort* port = _usartPortGet(USARTx);
+
+    if((port != 0) && port -> txBuffered){
+        _usartTxPush(port, data);
+        return;
+    }
+
+    if(port == 0){
+        while( !(USARTx -> SR & USART_SR_TXE));
+        USARTx -> DR = data;
+        return;
+    }
+
+    // Don't interleave with a DMA block still on its way out.
+    _usartDmaTxWait(port);
+
+    _usartFlagWait(USARTx, USART_SR_TXE, &(port -> stats.txWaitCycles));
+    _usartTxByte(port, data);
+    port -> stats.txBytes++;
 }
 
-/** USART Send String 
- * @brief Send a string of data in 8-bit chunks over UART.
- * @param USARTx: Which USART peripheral to send data over.
- * @param data: Pointer to **null-terminated** data set. 
- */
 void usartStringSend(USART_TypeDef* USARTx, uint8_t* data){
     while(*data){
         usartByteSend(USARTx, *(data++));
     }
 }
+
+uint16_t usartWrite(USART_TypeDef* USARTx, const uint8_t* buf, uint16_t len,
+        uint32_t timeoutUs, usartStatus* status){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t start = timebaseCyclesGet();
+    uint32_t spin = 0;
+    uint32_t waited;
+    uint16_t sent = 0;
+    uint8_t expired = 0;
+
+    if((buf == 0) && (len != 0)){
+        if(status) *status = USART_ERR_PARAM;
+        return 0;
+    }
+
+    if((port != 0) && port -> txBuffered){
+        sent = _usartTxWrite(port, buf, len, start, timeoutUs);
+    } else {
+        // DMA blocks own the data register until they finish.
+        while((port != 0) && port -> txDmaCount && !expired){
+            _usartDmaTxPoll(port);
+            expired = timebaseExpired(start, timeoutUs);
+        }
+        waited = timebaseCyclesGet() - start;
+
+        // Only the time spent spinning on TXE counts as waiting.
+        while((sent < len) && !expired){
+            if(!(USARTx -> SR & USART_SR_TXE)){
+                if(spin == 0) spin = timebaseCyclesGet() | 1;
+                expired = timebaseExpired(start, timeoutUs);
+                continue;
+            }
+            if(spin){
+                waited += timebaseCyclesGet() - spin;
+                spin = 0;
+            }
+            if(port != 0){
+                _usartTxByte(port, buf[sent++]);
+            } else {
+                USARTx -> DR = buf[sent++];
+            }
+        }
+        if(spin) waited += timebaseCyclesGet() - spin;
+
+        if(port != 0){
+            port -> stats.txBytes += sent;
+            port -> stats.txWaitCycles += waited;
+        }
+    }
+
+    if(status) *status = (sent < len) ? USART_ERR_TIMEOUT : USART_OK;
+    return sent;
+}
+
+uint16_t usartRead(USART_TypeDef* USARTx, uint8_t* buf, uint16_t len,
+        uint32_t timeoutUs, usartStatus* status){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t start = timebaseCyclesGet();
+    uint32_t spin = 0;
+    uint32_t waited = 0;
+    uint16_t got = 0;
+    uint16_t errors = 0;
+    uint32_t sr, primask;
+
+    if((buf == 0) && (len != 0)){
+        if(status) *status = USART_ERR_PARAM;
+        return 0;
+    }
+
+    if((port != 0) && port -> rxDmaEnabled){
+        if(port -> rxCallback){
+            if(status) *status = USART_ERR_BUSY;
+            return 0;
+        }
+
+        while(1){
+            primask = _usartCriticalEnter();
+            _usartDmaRxTrack(port);
+            _usartCriticalExit(primask);
+
+            got += _usartDmaRxCopy(port, &buf[got], len - got);
+
+            if(port -> rxFlowStopped){
+                primask = _usartCriticalEnter();
+                _usartRxFlowUpdate(port);
+                _usartCriticalExit(primask);
+            }
+            if((got >= len) || timebaseExpired(start, timeoutUs)) break;
+        }
+        errors = port -> rxErrors;
+    } else {
+        // Only the time spent spinning with RXNE clear counts as waiting.
+        while(got < len){
+            sr = USARTx -> SR;
+            if(!(sr & USART_SR_RXNE)){
+                if(spin == 0) spin = timebaseCyclesGet() | 1;
+                if(timebaseExpired(start, timeoutUs)) break;
+                continue;
+            }
+            if(spin){
+                waited += timebaseCyclesGet() - spin;
+                spin = 0;
+            }
+            // The SR read above plus this DR read clears the error flags.
+            errors |= (sr & AMP_USART_SR_ERRORS);
+            if(port != 0) _usartRxErrorsRecord(port, sr);
+            buf[got++] = USARTx -> DR;
+        }
+        if(spin) waited += timebaseCyclesGet() - spin;
+
+        if(port != 0){
+            port -> stats.rxBytes += got;
+            port -> stats.rxWaitCycles += waited;
+        }
+    }
+
+    if(status){
+        if(got < len) *status = USART_ERR_TIMEOUT;
+        else if(errors) *status = USART_ERR_LINE;
+        else *status = USART_OK;
+    }
+    return got;
+}
+
+uint16_t usartVPrintf(USART_TypeDef* USARTx, const char* fmt, va_list args){
+    usartFmtOut out;
+    char tmp[10];
+    const char* str;
+    uint16_t len;
+    uint8_t left, zero, neg;
+    int16_t width;
+    int32_t sv;
+
+    out.USARTx  = USARTx;
+    out.port    = _usartPortGet(USARTx);
+    out.count   = 0;
+    out.fill    = 0;
+
+    while(*fmt){
+        if(*fmt != '%'){
+            _usartFmtPut(&out, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        // Flags and width.
+        left = 0;
+        zero = 0;
+        neg = 0;
+        width = 0;
+        if(*fmt == '-'){ left = 1; fmt++; }
+        if(*fmt == '0'){ zero = 1; fmt++; }
+        while((*fmt >= '0') && (*fmt <= '9')){
+            width = (width * 10) + (*fmt++ - '0');
+        }
+        while(*fmt == 'l') fmt++;
+
+        str = &tmp[0];
+        switch(*fmt){
+            case 'u':
+                len = _usartFmtDec(tmp, va_arg(args, uint32_t));
+                str = &tmp[10 - len];
+                break;
+
+            case 'd':
+                sv = va_arg(args, int32_t);
+                neg = (sv < 0);
+                len = _usartFmtDec(tmp, neg ? -(uint32_t)sv : (uint32_t)sv);
+                str = &tmp[10 - len];
+                break;
+
+            case 'x':
+                len = _usartFmtHex(tmp, va_arg(args, uint32_t),
+                        _usartHexLower);
+                str = &tmp[10 - len];
+                break;
+
+            case 'X':
+                len = _usartFmtHex(tmp, va_arg(args, uint32_t),
+                        _usartHexUpper);
+                str = &tmp[10 - len];
+                break;
+
+            case 'c':
+                tmp[0] = (char)va_arg(args, int);
+                len = 1;
+                zero = 0;
+                break;
+
+            case 's':
+                str = va_arg(args, const char*);
+                if(str == 0) str = "(null)";
+                len = strlen(str);
+                zero = 0;
+                break;
+
+            case '%':
+                tmp[0] = '%';
+                len = 1;
+                break;
+
+            case '\0':
+                // Stray '%' at the very end, nothing to print.
+                continue;
+
+            default:
+                // Unknown conversion, echo it so the mistake is visible.
+                tmp[0] = *fmt;
+                len = 1;
+                break;
+        }
+        fmt++;
+
+        width -= len + neg;
+        if(neg && zero) _usartFmtPut(&out, '-');
+        if(!left) _usartFmtPad(&out, zero ? '0' : ' ', width);
+        if(neg && !zero) _usartFmtPut(&out, '-');
+        while(len--) _usartFmtPut(&out, *str++);
+        if(left) _usartFmtPad(&out, ' ', width);
+    }
+
+    _usartFmtFlush(&out);
+    return out.count;
+}
+
+uint16_t usartPrintf(USART_TypeDef* USARTx, const char* fmt, ...){
+    va_list args;
+    uint16_t count;
+
+    va_start(args, fmt);
+    count = usartVPrintf(USARTx, fmt, args);
+    va_end(args);
+
+    return count;
+}
+
+uint16_t usartBaudDivisorCompute(uint32_t fclk, uint32_t baud, uint8_t over8,
+        int32_t* errorPpm){
+    uint32_t div, actual;
+
+    if((baud == 0) || (fclk == 0)) return 0;
+
+    // fclk/baud is USARTDIV scaled by the oversampling factor, so its low
+    // 4 (or 3 with OVER8) bits are exactly the BRR fraction field.
+    div = (fclk + (baud / 2)) / baud;
+
+    if(over8){
+        // USARTDIV >= 1 and a 12-bit mantissa, fraction is only 3 bits.
+        if((div < 8) || (div > 0x7FFF)) return 0;
+        actual = fclk / div;
+        div = ((div & ~((uint32_t)0x07)) << 1) | (div & 0x07);
+    } else {
+        if((div < 16) || (div > 0xFFFF)) return 0;
+        actual = fclk / div;
+    }
+
+    if(errorPpm){
+        *errorPpm = (int32_t)((((int64_t)actual - (int64_t)baud) * 1000000)
+                / (int64_t)baud);
+    }
+    return (uint16_t)div;
+}
+
+uint8_t usartBaudRateSet(USART_TypeDef* USARTx, uint32_t baud,
+        int32_t* errorPpm){
+    uint32_t cr1 = USARTx -> CR1;
+    uint8_t ok;
+
+    // Don't corrupt a character that is still going out.
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+    ok = _usartBaudConfigure(USARTx, baud, errorPpm);
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+
+    return ok;
+}
+
+uint32_t usartBaudRateGet(USART_TypeDef* USARTx){
+    uint32_t brr = USARTx -> BRR;
+    uint32_t div;
+
+    if(USARTx -> CR1 & USART_CR1_OVER8){
+        div = ((brr & USART_BRR_DIV_Mantissa) >> 1) | (brr & 0x07);
+    } else {
+        div = brr;
+    }
+    if(div == 0) return 0;
+
+    return _usartClockGet(USARTx) / div;
+}
+
+uint8_t usartFlowControlSet(USART_TypeDef* USARTx, usartFlowControl flow){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t cr1 = USARTx -> CR1;
+    uint32_t primask;
+
+    if(port == 0) return 0;
+
+    // Handshake bits are only changed between characters.
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR3   &=  ~(USART_CR3_RTSE | USART_CR3_CTSE);
+    if(flow & USART_FLOW_RTS) USARTx -> CR3 |= USART_CR3_RTSE;
+    if(flow & USART_FLOW_CTS) USARTx -> CR3 |= USART_CR3_CTSE;
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+
+    primask = _usartCriticalEnter();
+    port -> rxFlowRts = (flow & USART_FLOW_RTS) ? 1 : 0;
+    if(!(port -> rxFlowRts) && port -> rxFlowStopped){
+        // Release a held-off DMA receiver.
+        USARTx -> CR3   |=  USART_CR3_DMAR;
+        USARTx -> CR1   |=  USART_CR1_IDLEIE;
+        port -> rxFlowStopped = 0;
+    }
+    _usartCriticalExit(primask);
+
+    return 1;
+}
+
+uint8_t usartMultiprocessorEnable(USART_TypeDef* USARTx, usartWakeMode wake,
+        uint8_t address){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(address > 0x0F) return 0;
+
+    // Frame format is only changed between characters.
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR2   =   (USARTx -> CR2 & ~(USART_CR2_ADD)) | address;
+
+    // Bit 8 is the address mark, so parity cannot share it.
+    USARTx -> CR1   &=  ~(USART_CR1_RWU | USART_CR1_WAKE | USART_CR1_M
+                        | USART_CR1_PCE);
+    if(wake == USART_WAKE_ADDRESS_MARK){
+        USARTx -> CR1 |= USART_CR1_WAKE | USART_CR1_M;
+    }
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+    return 1;
+}
+
+void usartMultiprocessorDisable(USART_TypeDef* USARTx){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR1   &=  ~(USART_CR1_RWU | USART_CR1_WAKE | USART_CR1_M);
+    USARTx -> CR1   |=  (cr1 & USART_CR1_UE);
+}
+
+uint8_t usartMute(USART_TypeDef* USARTx){
+    USARTx -> CR1 |= USART_CR1_RWU;
+    return (USARTx -> CR1 & USART_CR1_RWU) ? 1 : 0;
+}
+
+uint8_t usartAddressSend(USART_TypeDef* USARTx, uint8_t address){
+    usartPort* port = _usartPortGet(USARTx);
+
+    if(!(USARTx -> CR1 & USART_CR1_M) || !(USARTx -> CR1 & USART_CR1_WAKE)){
+        return 0;
+    }
+
+    // The address must not overtake data still in the ring or DMA.
+    if(port != 0) _usartDmaTxWait(port);
+    usartFlush(USARTx);
+
+    while( !(USARTx -> SR & USART_SR_TXE));
+    if(port != 0) _usartTxByte(port, 0x100 | address);
+    else USARTx -> DR = 0x100 | address;
+    return 1;
+}
+
+uint8_t usartRs485Enable(USART_TypeDef* USARTx, GPIO_TypeDef* deGPIO,
+        uint8_t dePin, uint8_t activeLow){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if((port == 0) || (deGPIO == 0) || (dePin > 15)) return 0;
+
+    // Only switch over with nothing on the wire.
+    usartFlush(USARTx);
+    _usartDmaTxWait(port);
+
+    RCC -> AHB1ENR |= (1UL << (((uint32_t)deGPIO - GPIOA_BASE) >> 10));
+
+    primask = _usartCriticalEnter();
+    port -> deGPIO      = deGPIO;
+    port -> deMask      = (1 << dePin);
+    port -> deActiveLow = activeLow ? 1 : 0;
+
+    // Receive first, then hand the pin over as a push-pull output.
+    _usartDeRelease(port);
+    deGPIO -> OTYPER    &=  ~(0x0001 << dePin);
+    deGPIO -> MODER     =   (deGPIO -> MODER & ~(0x03 << (2 * dePin)))
+                        | (0x01 << (2 * dePin));
+    _usartCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> irq);
+    return 1;
+}
+
+void usartRs485Disable(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if((port == 0) || (port -> deGPIO == 0)) return;
+
+    usartFlush(USARTx);
+    _usartDmaTxWait(port);
+
+    primask = _usartCriticalEnter();
+    _usartDeRelease(port);
+    port -> deGPIO = 0;
+    _usartCriticalExit(primask);
+}
+
+uint8_t usartHalfDuplexEnable(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx,
+        uint8_t txPin){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(txPin > 15) return 0;
+
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    // TX is released between frames, so it must not drive the line high.
+    GPIOx -> OTYPER     |=  (0x0001 << txPin);
+    GPIOx -> PUPDR      =   (GPIOx -> PUPDR & ~(0x03 << (2 * txPin)))
+                        | (0x01 << (2 * txPin));
+
+    // Single-wire needs LIN, smartcard, IrDA and the clock output off.
+    USARTx -> CR2   &=  ~(USART_CR2_LINEN | USART_CR2_CLKEN);
+    USARTx -> CR3   &=  ~(USART_CR3_SCEN | USART_CR3_IREN);
+    USARTx -> CR3   |=  USART_CR3_HDSEL;
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+    return 1;
+}
+
+void usartHalfDuplexDisable(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx,
+        uint8_t txPin){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(txPin > 15) return;
+
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR3   &=  ~(USART_CR3_HDSEL);
+    GPIOx -> OTYPER     &=  ~(0x0001 << txPin);
+    GPIOx -> PUPDR      &=  ~(0x03 << (2 * txPin));
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+}
+
+uint8_t usartRxInterruptEnable(USART_TypeDef* USARTx,
+        usartRxByteCallback callback){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if((port == 0) || (callback == 0) || port -> rxDmaEnabled) return 0;
+
+    primask = _usartCriticalEnter();
+    port -> rxByteCallback = callback;
+
+    // Drop anything stale, the SR then DR read clears RXNE and errors.
+    (void)USARTx -> SR;
+    (void)USARTx -> DR;
+    USARTx -> CR1   |=  USART_CR1_RXNEIE;
+    _usartCriticalExit(primask);
+
+    NVIC_EnableIRQ(port -> cfg -> irq);
+    return 1;
+}
+
+void usartRxInterruptDisable(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if(port == 0) return;
+
+    primask = _usartCriticalEnter();
+    USARTx -> CR1   &=  ~(USART_CR1_RXNEIE);
+    port -> rxByteCallback = 0;
+    _usartCriticalExit(primask);
+}
+
+void usartLinEnable(USART_TypeDef* USARTx, uint8_t break11){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR2   &=  ~(USART_CR2_STOP | USART_CR2_CLKEN | USART_CR2_LBDL);
+    USARTx -> CR3   &=  ~(USART_CR3_SCEN | USART_CR3_IREN | USART_CR3_HDSEL);
+    if(break11) USARTx -> CR2 |= USART_CR2_LBDL;
+    USARTx -> CR2   |=  USART_CR2_LINEN;
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+}
+
+void usartLinDisable(USART_TypeDef* USARTx){
+    uint32_t cr1 = USARTx -> CR1;
+
+    if(cr1 & USART_CR1_TE) while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR1 &= ~(USART_CR1_UE);
+
+    USARTx -> CR2   &=  ~(USART_CR2_LINEN | USART_CR2_LBDIE | USART_CR2_LBDL);
+
+    USARTx -> CR1 |= (cr1 & USART_CR1_UE);
+}
+
+void usartBreakSend(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask = _usartCriticalEnter();
+
+    if(port != 0) _usartDeAssert(port);
+    USARTx -> CR1   |=  USART_CR1_SBK;
+    _usartCriticalExit(primask);
+}
+
+uint8_t usartTxBufferEnable(USART_TypeDef* USARTx, usartTxPolicy policy){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || port -> txDmaEnabled) return 0;
+
+    // Let anything sent in blocking mode finish first.
+    while( !(USARTx -> SR & USART_SR_TC));
+
+    port -> txHead      = 0;
+    port -> txTail      = 0;
+    port -> txPolicy    = policy;
+    port -> txBuffered  = 1;
+
+    NVIC_EnableIRQ(port -> cfg -> irq);
+    return 1;
+}
+
+void usartTxBufferDisable(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || !(port -> txBuffered)) return;
+
+    usartFlush(USARTx);
+    USARTx -> CR1 &= ~(USART_CR1_TXEIE | USART_CR1_TCIE);
+    port -> txBuffered = 0;
+}
+
+void usartFlush(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+
+    if(port == 0){
+        while( !(USARTx -> SR & USART_SR_TC));
+        return;
+    }
+
+    if(port -> txBuffered){
+        while(port -> txHead != port -> txTail){
+            if(_usartIrqBlocked()) _usartTxDrainOne(port);
+        }
+    }
+
+    // Wait for the final stop bit to leave the shift register.
+    _usartFlagWait(USARTx, USART_SR_TC, &(port -> stats.txWaitCycles));
+}
+
+uint16_t usartTxPending(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || !(port -> txBuffered)) return 0;
+
+    return (port -> txHead - port -> txTail) & AMP_USART_TX_BUFFER_MASK;
+}
+
+uint8_t usartDmaTxEnable(USART_TypeDef* USARTx, usartDmaTxCallback callback){
+    usartPort* port = _usartPortGet(USARTx);
+    DMA_Stream_TypeDef* stream;
+
+    if((port == 0) || port -> txBuffered) return 0;
+    stream = port -> cfg -> txStream;
+
+    _usartDmaClockEnable(port -> cfg -> txDma);
+
+    // Stream must be fully stopped before it can be reconfigured.
+    stream -> CR    &=  ~(DMA_SxCR_EN);
+    while(stream -> CR & DMA_SxCR_EN);
+
+    stream -> PAR   =   (uint32_t)&(USARTx -> DR);
+    stream -> CR    =   (0
+                        | ((uint32_t)port -> cfg -> txChannel << 25) // Channel
+                        | DMA_SxCR_MINC     // Memory Increment
+                        | DMA_SxCR_DIR_0    // Memory to Peripheral
+                        | DMA_SxCR_TCIE     // Transfer Complete Int Enable
+                        | DMA_SxCR_TEIE     // Transfer Error Int Enable
+                        // | DMA_SxCR_PL_0  // Priority, 00=Low, 11=VeryHigh
+                        );
+    stream -> FCR   =   0;                  // Direct mode, no FIFO
+
+    port -> txDmaCallback   = callback;
+    port -> txDmaCount      = 0;
+    port -> txDmaSlot       = 0;
+    port -> txDmaEnabled    = 1;
+
+    // Let anything sent in blocking mode finish first.
+    while( !(USARTx -> SR & USART_SR_TC));
+    USARTx -> CR3 |= USART_CR3_DMAT;
+
+    NVIC_EnableIRQ(port -> cfg -> txDmaIrq);
+    return 1;
+}
+
+uint8_t usartDmaTxSubmit(USART_TypeDef* USARTx, const uint8_t* data,
+        uint16_t len){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+    uint8_t slot;
+
+    if((port == 0) || !(port -> txDmaEnabled) || (len == 0)) return 0;
+
+    primask = _usartCriticalEnter();
+    if(port -> txDmaCount >= 2){
+        _usartCriticalExit(primask);
+        return 0;
+    }
+
+    slot = (port -> txDmaSlot + port -> txDmaCount) & 0x01;
+    port -> txDmaBlocks[slot].data  = data;
+    port -> txDmaBlocks[slot].len   = len;
+    port -> txDmaCount++;
+
+    // Stream idle: start right away, otherwise the ISR picks it up.
+    if(port -> txDmaCount == 1) _usartDmaTxStart(port, slot);
+    _usartCriticalExit(primask);
+
+    return 1;
+}
+
+uint8_t usartDmaTxFree(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || !(port -> txDmaEnabled)) return 0;
+
+    // Callers spin on this, so retire a finished block if the ISR can't.
+    if(port -> txDmaCount == 2) _usartDmaTxPoll(port);
+    return 2 - port -> txDmaCount;
+}
+
+uint8_t usartDmaTxEnabled(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    return (port != 0) && port -> txDmaEnabled;
+}
+
+void usartDmaTxDisable(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || !(port -> txDmaEnabled)) return;
+
+    _usartDmaTxWait(port);
+    while( !(USARTx -> SR & USART_SR_TC));
+
+    USARTx -> CR3 &= ~(USART_CR3_DMAT);
+    NVIC_DisableIRQ(port -> cfg -> txDmaIrq);
+    port -> txDmaEnabled = 0;
+}
+
+uint8_t usartStatsGet(USART_TypeDef* USARTx, usartStats* stats){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if((port == 0) || (stats == 0)) return 0;
+
+    primask = _usartCriticalEnter();
+    *stats = port -> stats;
+    _usartCriticalExit(primask);
+
+    return 1;
+}
+
+void usartStatsReset(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+
+    if(port == 0) return;
+
+    primask = _usartCriticalEnter();
+    memset(&(port -> stats), 0, sizeof(port -> stats));
+    _usartCriticalExit(primask);
+}
+
+void usartDmaTxIRQHandler(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    usartDmaBlock done;
+    uint32_t flags;
+
+    if(port == 0) return;
+
+    flags = _usartDmaFlagsGet(port -> cfg -> txDma, port -> cfg -> txStreamNum);
+    _usartDmaFlagsClear(port -> cfg -> txDma, port -> cfg -> txStreamNum,
+            flags);
+
+    // A transfer error also disables the stream, so the block is finished
+    // either way. Release it so the queue keeps moving.
+    if(!(flags & (AMP_USART_DMA_FLAG_TC | AMP_USART_DMA_FLAG_TE))) return;
+    if(port -> txDmaCount == 0) return;
+
+    done = port -> txDmaBlocks[port -> txDmaSlot];
+    port -> txDmaCount--;
+    port -> stats.txBytes += done.len - port -> cfg -> txStream -> NDTR;
+
+    // Start the waiting block before the callback to keep the line busy.
+    // Otherwise re-arm TC in case it fired while this block was counted.
+    if(port -> txDmaCount) _usartDmaTxStart(port, port -> txDmaSlot ^ 0x01);
+    else if(port -> deGPIO) USARTx -> CR1 |= USART_CR1_TCIE;
+
+    if(port -> txDmaCallback){
+        port -> txDmaCallback(USARTx, done.data, done.len);
+    }
+}
+
+uint8_t usartDmaRxEnable(USART_TypeDef* USARTx, uint8_t* buffer,
+        uint16_t size, usartRxCallback callback){
+    usartPort* port = _usartPortGet(USARTx);
+    DMA_Stream_TypeDef* stream;
+
+    if((port == 0) || (buffer == 0) || (size < 2)) return 0;
+    stream = port -> cfg -> rxStream;
+
+    _usartDmaClockEnable(port -> cfg -> rxDma);
+
+    stream -> CR    &=  ~(DMA_SxCR_EN);
+    while(stream -> CR & DMA_SxCR_EN);
+    _usartDmaFlagsClear(port -> cfg -> rxDma, port -> cfg -> rxStreamNum,
+            AMP_USART_DMA_FLAGS_ALL);
+
+    port -> rxBuffer    = buffer;
+    port -> rxSize      = size;
+    port -> rxRead      = 0;
+    port -> rxErrors    = 0;
+    port -> rxCallback  = callback;
+    port -> rxFlowStopped = 0;
+    port -> rxDmaSeen   = 0;
+
+    stream -> PAR   =   (uint32_t)&(USARTx -> DR);
+    stream -> M0AR  =   (uint32_t)buffer;
+    stream -> NDTR  =   size;
+    stream -> CR    =   (0
+                        | ((uint32_t)port -> cfg -> rxChannel << 25) // Channel
+                        | DMA_SxCR_MINC     // Memory Increment
+                        | DMA_SxCR_CIRC     // Circular Mode
+                                            // DIR = 00, Peripheral to Memory
+                        | DMA_SxCR_HTIE     // Half Transfer Int Enable
+                        | DMA_SxCR_TCIE     // Transfer Complete Int Enable
+                        | DMA_SxCR_TEIE     // Transfer Error Int Enable
+                        );
+    stream -> FCR   =   0;                  // Direct mode, no FIFO
+
+    // Drop any stale IDLE/RXNE state, the SR then DR read clears both.
+    (void)USARTx -> SR;
+    (void)USARTx -> DR;
+
+    stream -> CR    |=  DMA_SxCR_EN;
+    USARTx -> CR3   |=  USART_CR3_DMAR | USART_CR3_EIE;
+    USARTx -> CR1   |=  USART_CR1_IDLEIE;
+    port -> rxDmaEnabled = 1;
+
+    NVIC_EnableIRQ(port -> cfg -> rxDmaIrq);
+    NVIC_EnableIRQ(port -> cfg -> irq);
+    return 1;
+}
+
+void usartDmaRxDisable(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    if((port == 0) || !(port -> rxDmaEnabled)) return;
+
+    USARTx -> CR1   &=  ~(USART_CR1_IDLEIE);
+    USARTx -> CR3   &=  ~(USART_CR3_DMAR | USART_CR3_EIE);
+    port -> cfg -> rxStream -> CR &= ~(DMA_SxCR_EN);
+    while(port -> cfg -> rxStream -> CR & DMA_SxCR_EN);
+
+    NVIC_DisableIRQ(port -> cfg -> rxDmaIrq);
+    port -> rxDmaEnabled = 0;
+}
+
+uint16_t usartDmaRxPoll(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+    uint16_t pending;
+
+    if((port == 0) || !(port -> rxDmaEnabled)) return 0;
+
+    primask = _usartCriticalEnter();
+    _usartDmaRxTrack(port);
+    _usartDmaRxDeliver(port);
+    _usartRxFlowUpdate(port);
+    pending = _usartDmaRxPending(port);
+    _usartCriticalExit(primask);
+
+    return pending;
+}
+
+uint16_t usartRxErrors(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t primask;
+    uint16_t errors;
+
+    if(port == 0) return 0;
+
+    primask = _usartCriticalEnter();
+    errors = port -> rxErrors;
+    port -> rxErrors = 0;
+    _usartCriticalExit(primask);
+
+    return errors;
+}
+
+void usartDmaRxIRQHandler(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t flags;
+
+    if(port == 0) return;
+
+    flags = _usartDmaFlagsGet(port -> cfg -> rxDma, port -> cfg -> rxStreamNum);
+    _usartDmaFlagsClear(port -> cfg -> rxDma, port -> cfg -> rxStreamNum,
+            flags);
+
+    // Half and full buffer marks, so long bursts are handed over before the
+    // DMA laps the read index.
+    if(flags & (AMP_USART_DMA_FLAG_HT | AMP_USART_DMA_FLAG_TC)){
+        _usartDmaRxTrack(port);
+        _usartDmaRxDeliver(port);
+        _usartRxFlowUpdate(port);
+    }
+}
+
+void usartIRQHandler(USART_TypeDef* USARTx){
+    usartPort* port = _usartPortGet(USARTx);
+    uint32_t sr = USARTx -> SR;
+    uint32_t cr1 = USARTx -> CR1;
+    uint16_t tail, data;
+
+    if(port == 0) return;
+
+    // Receive errors. All of them, ORE included, clear when the DMA reads
+    // DR after our SR read. With ORE the byte still in DR is valid and
+    // belongs to the DMA; only the one behind it was lost.
+    if(port -> rxDmaEnabled && (sr & AMP_USART_SR_ERRORS)){
+        _usartRxErrorsRecord(port, sr);
+    }
+
+    // Per-character receive. The SR read above plus this DR read clears
+    // RXNE and any error flags that came with the character.
+    if(port -> rxByteCallback && (cr1 & USART_CR1_RXNEIE)
+            && (sr & (USART_SR_RXNE | USART_SR_ORE))){
+        data = USARTx -> DR;
+        _usartRxErrorsRecord(port, sr);
+        port -> stats.rxBytes++;
+        port -> rxByteCallback(USARTx, data, sr & AMP_USART_SR_ERRORS);
+    }
+
+    // Line went idle after a burst: deliver the frame now.
+    if((cr1 & USART_CR1_IDLEIE) && (sr & USART_SR_IDLE)){
+        (void)USARTx -> DR;
+        if(port -> rxDmaEnabled){
+            _usartDmaRxTrack(port);
+            _usartDmaRxDeliver(port);
+            _usartRxFlowUpdate(port);
+        }
+    }
+
+    // Data register empty: feed the next byte, or hand over to TC when dry.
+    if((cr1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE)){
+        tail = port -> txTail;
+        if(tail != port -> txHead){
+            USARTx -> DR = port -> txBuffer[tail];
+            port -> txTail = (tail + 1) & AMP_USART_TX_BUFFER_MASK;
+            port -> stats.txBytes++;
+        } else {
+            USARTx -> CR1 = (USARTx -> CR1 & ~(USART_CR1_TXEIE))
+                | USART_CR1_TCIE;
+        }
+    }
+
+    // Transmission complete: the line is idle unless more data was queued.
+    // This is the only place the RS-485 driver is released, so the stop bit
+    // of the last byte is always on the wire first.
+    if((cr1 & USART_CR1_TCIE) && (sr & USART_SR_TC)){
+        USARTx -> CR1 &= ~(USART_CR1_TCIE);
+        if(!(USARTx -> CR1 & USART_CR1_TXEIE)){
+            if(port -> txDmaCount == 0) _usartDeRelease(port);
+        }
+    }
+}
+
+// Interrupt Vectors
+// These override the weak aliases in the startup file.
+void USART1_IRQHandler(void){
+    usartIRQHandler(USART1);
+}
+
+void USART2_IRQHandler(void){
+    usartIRQHandler(USART2);
+}
+
+void USART6_IRQHandler(void){
+    usartIRQHandler(USART6);
+}
+
+void DMA2_Stream7_IRQHandler(void){
+    usartDmaTxIRQHandler(USART1);
+}
+
+void DMA1_Stream6_IRQHandler(void){
+    usartDmaTxIRQHandler(USART2);
+}
+
+void DMA2_Stream6_IRQHandler(void){
+    usartDmaTxIRQHandler(USART6);
+}
+
+void DMA2_Stream2_IRQHandler(void){
+    usartDmaRxIRQHandler(USART1);
+}
+
+void DMA1_Stream5_IRQHandler(void){
+    usartDmaRxIRQHandler(USART2);
+}
+
+void DMA2_Stream1_IRQHandler(void){
+    usartDmaRxIRQHandler(USART6);
+}
@@ -0,0 +1,144 @@
+/**
+ * @file frame.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief Framed Binary Protocol for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details public function declarations for the COBS framing layer
+ * that carries binary records over a USART, as part of the
+ * stm32f4xx-amperture-periphlib package.
+ *
+ * Each frame is [seq][payload ...][crc16 lo][crc16 hi], COBS encoded and
+ * terminated by a single 0x00. COBS guarantees 0x00 never appears inside a
+ * frame, so a receiver that lost a byte resynchronises at the next
+ * delimiter. The CRC is CRC-16/CCITT-FALSE over seq and payload. Overhead
+ * is 5 bytes per frame plus 1 per 254 data bytes; payloads of 100 bytes or
+ * more stay above 95% wire efficiency.
+ */
+#ifndef AMP_FRAME_H
+#define AMP_FRAME_H
+
+// Defines
+
+// Largest payload a frameTx/frameRx is sized for.
+#ifndef FRAME_MAX_PAYLOAD
+#define FRAME_MAX_PAYLOAD 256
+#endif
+
+// Bound on frameWrite waiting for room. A full frame is about 23ms on the
+// wire at 115200 baud, and at most one has to finish before a buffer frees.
+#ifndef AMP_FRAME_TIMEOUT_US
+#define AMP_FRAME_TIMEOUT_US 50000
+#endif
+
+// Worst-case encoded size of a payload: seq and CRC are 3 more data bytes,
+// COBS adds one code byte per 254 data bytes plus one, then the delimiter.
+#define FRAME_ENCODED_MAX(len) ((len) + 3 + (((len) + 3) / 254) + 2)
+
+// Typedefs
+
+/** Frame Rx Callback
+ * @brief Called for every frame that passes its CRC.
+ * @param seq: Sequence number from the frame.
+ * @param *payload: Decoded payload, valid only during the call.
+ * @param len: Payload length.
+ */
+typedef void (*frameRxCallback)(uint8_t seq, const uint8_t* payload,
+        uint16_t len);
+
+/** Frame Tx
+ * @brief Sender state: next sequence number and two encode buffers.
+ *
+ * With DMA transmit one buffer is on the wire while the next frame is
+ * encoded into the other, so they alternate. Zero it before first use.
+ */
+typedef struct frameTx {
+    uint8_t     seq;
+    uint8_t     slot;           // Buffer the next frame is encoded into.
+    uint8_t     buf[2][FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+} frameTx;
+
+/** Frame Rx
+ * @brief Incremental decoder state and error counters.
+ */
+typedef struct frameRx {
+    frameRxCallback callback;
+    uint16_t    len;            // Decoded bytes so far, seq and CRC included.
+    uint8_t     code;           // COBS code of the current block.
+    uint8_t     remaining;      // Data bytes left in the current block.
+    uint8_t     overflow;       // Current frame outgrew buf, drop it.
+    uint8_t     synced;         // A frame has been received, seq is valid.
+    uint8_t     nextSeq;
+    uint32_t    frames;         // Good frames delivered.
+    uint32_t    crcErrors;      // Frames dropped on CRC or COBS structure.
+    uint32_t    overflows;      // Frames dropped for exceeding buf.
+    uint32_t    lost;           // Gaps seen in the sequence numbers.
+    uint8_t     buf[FRAME_MAX_PAYLOAD + 3];
+} frameRx;
+
+// Public Functions
+
+/** Frame CRC16
+ * @brief CRC-16/CCITT-FALSE, table driven.
+ * @param crc: Running CRC, start with 0xFFFF.
+ * @param *data: Data to add.
+ * @param len: Number of bytes.
+ * @retval Updated CRC.
+ */
+uint16_t frameCrc16(uint16_t crc, const uint8_t* data, uint16_t len);
+
+
+/** Frame Encode
+ * @brief Builds one complete frame in a single pass over the payload.
+ * @param *out: Destination, FRAME_ENCODED_MAX(len) bytes are always enough.
+ * @param outSize: Size of out.
+ * @param seq: Sequence number to stamp on the frame.
+ * @param *payload: Record to send.
+ * @param len: Record length.
+ * @retval Encoded length including the delimiter, 0 if out is too small.
+ *
+ * The output can go straight to usartDmaTxSubmit without another copy.
+ */
+uint16_t frameEncode(uint8_t* out, uint16_t outSize, uint8_t seq,
+        const uint8_t* payload, uint16_t len);
+
+
+/** Frame Write
+ * @brief Encodes a payload with the next sequence number and sends it.
+ * @param *USARTx: Which USART peripheral to send over.
+ * @param *tx: Sender state, one per stream.
+ * @param *payload: Record to send, up to FRAME_MAX_PAYLOAD bytes.
+ * @param len: Record length.
+ * @retval 1 if the whole frame was queued, 0 otherwise.
+ *
+ * On a port set up with usartDmaTxEnable the frame is encoded into a tx
+ * buffer and submitted as is, no copy; the port's DMA queue must then be
+ * left to this stream. Any other port gets the frame through usartWrite.
+ * Waiting for room is bounded by AMP_FRAME_TIMEOUT_US. A DMA frame that
+ * times out is never started; a usartWrite one may be cut short, which the
+ * receiver drops at the next delimiter.
+ */
+uint8_t frameWrite(USART_TypeDef* USARTx, frameTx* tx,
+        const uint8_t* payload, uint16_t len);
+
+
+/** Frame Rx Init
+ * @brief Resets a decoder and its counters.
+ * @param *rx: Decoder state.
+ * @param callback: Called for each good frame.
+ */
+void frameRxInit(frameRx* rx, frameRxCallback callback);
+
+
+/** Frame Rx Feed
+ * @brief Pushes received bytes through the decoder.
+ * @param *rx: Decoder state.
+ * @param *data: Received bytes, any chunking.
+ * @param len: Number of bytes.
+ * @retval len, so it can be returned straight from a usartRxCallback.
+ */
+uint16_t frameRxFeed(frameRx* rx, const uint8_t* data, uint16_t len);
+
+#endif /* AMP_FRAME_H */
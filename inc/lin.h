@@ -0,0 +1,168 @@
+/**
+ * @file lin.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief LIN Master Library for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details public function declarations for a LIN 2.x master
+ * running a static schedule table, as part of the
+ * stm32f4xx-amperture-periphlib package.
+ *
+ * A general purpose timer (TIM2-TIM5) starts each slot from its update
+ * interrupt, so header timing depends only on interrupt latency, not on
+ * the main loop. The header and any published data are queued on the
+ * USART Tx ring in one go. The bus echo and any slave response are checked
+ * byte by byte in the USART interrupt.
+ */
+#ifndef AMP_LIN_H
+#define AMP_LIN_H
+
+// Defines
+
+// Most data bytes in a LIN frame.
+#define LIN_MAX_DATA 8
+
+// Shortest slot that fits a frame of len data bytes at baud: the LIN
+// TFrame_Max of 1.4 times the nominal 34 + 10 * (len + 1) bits.
+#define LIN_SLOT_MIN_US(len, baud) \
+    ((14UL * (34 + (10 * ((len) + 1))) * 100000UL) / (baud))
+
+// Typedefs
+
+/** LIN Direction
+ * @brief Who sends the response of a scheduled frame.
+ */
+typedef enum linDirection {
+    LIN_PUBLISH,            // The master sends the response.
+    LIN_SUBSCRIBE           // A slave sends the response.
+} linDirection;
+
+/** LIN Status
+ * @brief Outcome of one scheduled frame.
+ */
+typedef enum linStatus {
+    LIN_OK = 0,
+    LIN_ERR_NO_RESPONSE,    // Nothing after the header before slot end.
+    LIN_ERR_INCOMPLETE,     // Response started but was cut short.
+    LIN_ERR_CHECKSUM,       // Response checksum mismatch.
+    LIN_ERR_READBACK,       // Echo of our own bytes differs, bus conflict.
+    LIN_ERR_LINE            // Framing, noise or overrun error in a byte.
+} linStatus;
+
+/** LIN Schedule Entry
+ * @brief One slot of a schedule table.
+ */
+typedef struct linScheduleEntry {
+    uint8_t         id;         // Frame ID, 0 to 63.
+    linDirection    dir;
+    uint8_t         len;        // Data bytes, 1 to LIN_MAX_DATA.
+    uint8_t*        data;       // Source when publishing, else destination.
+    uint32_t        slotUs;     // Time from this header to the next one.
+} linScheduleEntry;
+
+/** LIN Frame Callback
+ * @brief Called from interrupt context once per slot with its outcome.
+ * @param *entry: The schedule entry that just finished.
+ * @param status: How it went. Subscribed data is only written on LIN_OK.
+ */
+typedef void (*linFrameCallback)(const linScheduleEntry* entry,
+        linStatus status);
+
+/** LIN Master
+ * @brief Master state, one per LIN bus.
+ */
+typedef struct linMaster {
+    USART_TypeDef*              USARTx;
+    TIM_TypeDef*                TIMx;
+    linFrameCallback            callback;
+
+    const linScheduleEntry*     table;
+    uint8_t                     count;
+    volatile uint8_t            slot;
+    const linScheduleEntry*     pendingTable;   // Switch at next boundary.
+    uint8_t                     pendingCount;
+    uint8_t                     switchNext;
+
+    volatile uint8_t            state;
+    uint8_t                     pid;
+    uint8_t                     rxLen;
+    uint8_t                     rxExpected;
+    uint8_t                     rxBuf[LIN_MAX_DATA + 1];
+    uint8_t                     txBuf[LIN_MAX_DATA + 3];
+
+    uint32_t                    frames;         // Slots completed with LIN_OK.
+    uint32_t                    errors;         // Slots with any other status.
+} linMaster;
+
+// Public Functions
+
+/** LIN Master Init
+ * @brief Puts a USART into LIN mode and prepares a timer for scheduling.
+ * @param *lin: Master state, must stay valid while the bus runs.
+ * @param *USARTx: Port already set up with usartInit.
+ * @param *TIMx: TIM2, TIM3, TIM4 or TIM5, used only by this master.
+ * @param baud: Bus rate, 19200 for most LIN 2.x clusters.
+ * @retval 1 for success, 0 for an unsupported port, timer or baud rate.
+ *
+ * Enables the port's Tx ring and per-character receive interrupt. The
+ * timer ticks at 1MHz and its interrupt takes the USART's priority, so set
+ * that first; slot start jitter is then at most one receive interrupt. On
+ * failure LIN mode, the timer and any previous registration are left as
+ * they were.
+ */
+uint8_t linMasterInit(linMaster* lin, USART_TypeDef* USARTx,
+        TIM_TypeDef* TIMx, uint32_t baud);
+
+
+/** LIN Schedule Start
+ * @brief Runs a schedule table in a loop, or switches to a new one.
+ * @param *lin: Master state.
+ * @param *table: Slots, must stay valid while in use.
+ * @param count: Number of slots.
+ * @param callback: Called per slot from interrupt context, may be 0.
+ * @retval 1 for success, 0 on a bad entry or if a switch is already due.
+ *
+ * When a table is already running the new one takes over at the next slot
+ * boundary, so no frame is cut short. TIM3 and TIM4 are 16-bit, which
+ * limits slots to 65535us on them.
+ */
+uint8_t linScheduleStart(linMaster* lin, const linScheduleEntry* table,
+        uint8_t count, linFrameCallback callback);
+
+
+/** LIN Schedule Stop
+ * @brief Stops the schedule timer. A frame in flight is abandoned.
+ * @param *lin: Master state.
+ * @retval void
+ */
+void linScheduleStop(linMaster* lin);
+
+
+/** LIN Timer IRQ Handler
+ * @brief Slot boundary handling, call from the timer's interrupt vector.
+ * @param *lin: Master state using that timer.
+ * @retval void
+ */
+void linTimerIRQHandler(linMaster* lin);
+
+
+/** LIN PID
+ * @brief Adds the two parity bits to a frame ID.
+ * @param id: Frame ID, 0 to 63.
+ * @retval Protected identifier.
+ */
+uint8_t linPid(uint8_t id);
+
+
+/** LIN Checksum
+ * @brief Inverted 8-bit sum with carry.
+ * @param pid: Protected ID for the enhanced checksum, 0 for classic.
+ * @param *data: Response data.
+ * @param len: Number of data bytes.
+ * @retval Checksum byte.
+ */
+uint8_t linChecksum(uint8_t pid, const uint8_t* data, uint8_t len);
+
+#endif /* AMP_LIN_H */
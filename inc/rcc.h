@@ -0,0 +1,49 @@
+/**
+ * @file rcc.h
+ * @author W. Alex Best
+ * @date 17 Oct 2026
+ * @website http://www.amperture.com
+ * @license Modified BSD License
+ * @brief RCC Clock Query Library for stm32f4xx-amperture-periphlib package.
+ *
+ * This file details public function declarations for reading back the live
+ * clock tree configuration on the stm32f4 family of microcontrollers, as part
+ * of the stm32f4xx-amperture-periphlib package. Peripheral drivers use these
+ * to derive their timing from the real bus clocks instead of constants.
+ */
+#ifndef AMP_RCC_H
+#define AMP_RCC_H
+
+// Public Functions
+
+/** RCC SYSCLK Get
+ * @brief Computes SYSCLK from the active clock source and PLL settings.
+ * @retval SYSCLK frequency in Hz.
+ *
+ * HSE_VALUE and HSI_VALUE come from the CMSIS device header; override
+ * HSE_VALUE to match the board's crystal or bypass clock.
+ */
+uint32_t rccSysclkGet(void);
+
+
+/** RCC HCLK Get
+ * @brief Computes the AHB clock from SYSCLK and the HPRE prescaler.
+ * @retval HCLK frequency in Hz.
+ */
+uint32_t rccHclkGet(void);
+
+
+/** RCC PCLK1 Get
+ * @brief Computes the APB1 clock (USART2, I2Cx, TIM2-5) from HCLK and PPRE1.
+ * @retval PCLK1 frequency in Hz.
+ */
+uint32_t rccPclk1Get(void);
+
+
+/** RCC PCLK2 Get
+ * @brief Computes the APB2 clock (USART1, USART6, SPI1) from HCLK and PPRE2.
+ * @retval PCLK2 frequency in Hz.
+ */
+uint32_t rccPclk2Get(void);
+
+#endif /* AMP_RCC_H */
@@ -13,6 +13,109 @@
 #ifndef AMP_USART_H
 #define AMP_USART_H
 
+#include <stdarg.h>
+
+// Defines
+
+// Baud rate applied by usartInit, change later with usartBaudRateSet.
+#ifndef AMP_USART_BAUD_RATE
+#define AMP_USART_BAUD_RATE 115200
+#endif
+
+// Size of the per-port interrupt driven transmit ring, must be a power of 2.
+#ifndef AMP_USART_TX_BUFFER_SIZE
+#define AMP_USART_TX_BUFFER_SIZE 256
+#endif
+#define AMP_USART_TX_BUFFER_MASK (AMP_USART_TX_BUFFER_SIZE - 1)
+
+// Typedefs
+
+/** USART Status
+ * @brief Result codes for the length-based transfer functions.
+ */
+typedef enum usartStatus {
+    USART_OK = 0,
+    USART_ERR_PARAM,        // Bad pointer or unsupported peripheral.
+    USART_ERR_TIMEOUT,      // Ran out of time before len bytes moved.
+    USART_ERR_BUSY,         // Port is owned by another mode, e.g. Rx callback.
+    USART_ERR_LINE          // ORE, FE, NE or PE seen, see usartRxErrors.
+} usartStatus;
+
+/** USART Tx Full Policy
+ * @brief What usartByteSend does when the transmit ring has no room left.
+ */
+typedef enum usartTxPolicy {
+    USART_TX_POLICY_BLOCK,      // Wait for the interrupt to free a slot.
+    USART_TX_POLICY_DROP,       // Discard the new byte.
+    USART_TX_POLICY_OVERWRITE   // Discard the oldest unsent byte.
+} usartTxPolicy;
+
+/** USART Flow Control
+ * @brief Hardware handshake lines used by usartFlowControlSet.
+ */
+typedef enum usartFlowControl {
+    USART_FLOW_NONE     = 0,
+    USART_FLOW_RTS      = 1,    // Hold off the sender when we can't keep up.
+    USART_FLOW_CTS      = 2,    // Only transmit while the peer allows it.
+    USART_FLOW_RTS_CTS  = 3
+} usartFlowControl;
+
+/** USART Wake Method
+ * @brief How a muted receiver on a multi-drop bus is woken up.
+ */
+typedef enum usartWakeMode {
+    USART_WAKE_IDLE_LINE,       // Wake on an idle frame, software filters.
+    USART_WAKE_ADDRESS_MARK     // 9-bit frames, wake on a matching address.
+} usartWakeMode;
+
+/** USART Statistics
+ * @brief Per-port counters, see usartStatsGet. All counts wrap silently.
+ */
+typedef struct usartStats {
+    uint32_t txBytes;           // Bytes handed to the data register.
+    uint32_t rxBytes;           // Bytes taken from the data register.
+    uint32_t txDropped;         // Bytes lost to the DROP/OVERWRITE policies.
+    uint32_t overrunErrors;     // ORE, a byte arrived before DR was read.
+    uint32_t framingErrors;     // FE, bad stop bit (baud mismatch, break).
+    uint32_t noiseErrors;       // NE, samples within a bit disagreed.
+    uint32_t parityErrors;      // PE
+    uint32_t txWaitCycles;      // CPU cycles spent spinning on TXE/TC.
+    uint32_t rxWaitCycles;      // CPU cycles spent spinning on RXNE.
+    uint16_t txPeak;            // Highest Tx ring occupancy seen.
+    uint16_t rxPeak;            // Highest unconsumed Rx DMA fill seen.
+} usartStats;
+
+/** USART DMA Tx Done Callback
+ * @brief Called from the DMA interrupt once a submitted block has been sent.
+ * @param *USARTx: Which USART peripheral sent the block.
+ * @param *data: The pointer passed to usartDmaTxSubmit, free to reuse now.
+ * @param len: The length passed to usartDmaTxSubmit.
+ */
+typedef void (*usartDmaTxCallback)(USART_TypeDef* USARTx, const uint8_t* data,
+        uint16_t len);
+
+/** USART Rx Callback
+ * @brief Called from interrupt context with newly received bytes, in place.
+ * @param *USARTx: Which USART peripheral received the data.
+ * @param *data: Start of the new bytes inside the circular DMA buffer.
+ * @param len: Number of contiguous bytes available at data.
+ * @retval How many of those bytes were consumed. Unconsumed bytes are handed
+ * out again, together with anything newer, on the next event.
+ *
+ * A frame that wraps the end of the buffer is delivered in two calls.
+ */
+typedef uint16_t (*usartRxCallback)(USART_TypeDef* USARTx,
+        const uint8_t* data, uint16_t len);
+
+/** USART Rx Byte Callback
+ * @brief Called from the USART interrupt for every received character.
+ * @param *USARTx: Which USART peripheral received the character.
+ * @param data: The character, 9 bits wide in 9-bit modes.
+ * @param errors: USART_SR_ORE/FE/NE/PE seen with this character, or 0.
+ */
+typedef void (*usartRxByteCallback)(USART_TypeDef* USARTx, uint16_t data,
+        uint16_t errors);
+
 // Public Functions
 
 /** USART Init
@@ -27,6 +130,10 @@
  * @param afMode: Alternate Function mode for GPIO pins, refer to datasheet.
  * @retval void
  * @see http://www.st.com/st-web-ui/static/active/en/resource/technical/document/datasheet/DM00102166.pdf
+ *
+ * The USART and GPIO port clocks are enabled from tables in usart.c, so any
+ * of USART1, USART2 and USART6 can be brought up side by side, each with its
+ * own buffers and mode. Calling it again resets that port's driver state.
  */
 void usartInit(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx, uint8_t txPin,
         uint8_t rxPin, uint8_t ctsPin, uint8_t rtsPin, 
@@ -56,4 +163,446 @@ uint8_t usartByteReceive(USART_TypeDef *USARTx);
  */
 void usartStringSend(USART_TypeDef* USARTx, uint8_t* dataPtr);
 
+
+/** USART Write
+ * @brief Sends a binary buffer, zero bytes included, with a bounded wait.
+ * @param *USARTx: Which USART peripheral to send over.
+ * @param *buf: Data to send.
+ * @param len: Number of bytes to send.
+ * @param timeoutUs: Limit for the whole call in microseconds, 0 to only take
+ * what fits right now, TIMEBASE_WAIT_FOREVER for no limit.
+ * @param *status: Optional, receives USART_OK or the reason for stopping.
+ * @retval Number of bytes sent, or queued on a buffered port.
+ *
+ * On a buffered port the data is copied into the ring in bulk and the
+ * timeout replaces the full-ring policy.
+ */
+uint16_t usartWrite(USART_TypeDef* USARTx, const uint8_t* buf, uint16_t len,
+        uint32_t timeoutUs, usartStatus* status);
+
+
+/** USART Read
+ * @brief Receives up to len bytes into a buffer with a bounded wait.
+ * @param *USARTx: Which USART peripheral to read from.
+ * @param *buf: Destination buffer.
+ * @param len: Number of bytes wanted.
+ * @param timeoutUs: Limit for the whole call in microseconds, 0 to only take
+ * what has already arrived, TIMEBASE_WAIT_FOREVER for no limit.
+ * @param *status: Optional, receives USART_OK or the reason for stopping.
+ * @retval Number of bytes received.
+ *
+ * If circular DMA receive is running without a callback, data is copied out
+ * of the DMA buffer; with a callback the port is busy and nothing is read.
+ */
+uint16_t usartRead(USART_TypeDef* USARTx, uint8_t* buf, uint16_t len,
+        uint32_t timeoutUs, usartStatus* status);
+
+
+/** USART Printf
+ * @brief Small formatted print straight into the USART transmit path.
+ * @param *USARTx: Which USART peripheral to print on.
+ * @param *fmt: Format string, see below.
+ * @retval Number of characters produced.
+ *
+ * Supports %u, %d, %x, %X, %c, %s and %%, with an optional '-' (left
+ * justify) or '0' (zero pad) flag and a decimal field width, e.g. "%02u".
+ * 'l' length modifiers are accepted and ignored since int is 32 bits.
+ * No heap, no newlib printf: output is staged in a small stack buffer and
+ * copied into the transmit ring in bulk, honouring the port's Tx policy.
+ */
+uint16_t usartPrintf(USART_TypeDef* USARTx, const char* fmt, ...);
+
+
+/** USART VPrintf
+ * @brief usartPrintf taking a va_list, for wrapping in other printers.
+ * @param *USARTx: Which USART peripheral to print on.
+ * @param *fmt: Format string, as for usartPrintf.
+ * @param args: Argument list.
+ * @retval Number of characters produced.
+ */
+uint16_t usartVPrintf(USART_TypeDef* USARTx, const char* fmt, va_list args);
+
+
+/** USART Baud Rate Set
+ * @brief Reprograms the baud rate from the live APB clock, without re-init.
+ * @param *USARTx: Which USART peripheral to retune.
+ * @param baud: Requested baud rate in bits per second.
+ * @param *errorPpm: Optional, receives the achieved rate error in ppm.
+ * @retval 1 for success, 0 if the rate is out of reach for the bus clock.
+ *
+ * 16x oversampling is preferred for its noise margin; 8x (OVER8) is used
+ * when the rate needs it or when it lands measurably closer. This reaches
+ * PCLK/8, e.g. 10.5 Mbaud on an 84 MHz APB2 or 5.25 Mbaud on a 42 MHz APB1.
+ * Waits for any byte in progress before touching the peripheral.
+ */
+uint8_t usartBaudRateSet(USART_TypeDef* USARTx, uint32_t baud,
+        int32_t* errorPpm);
+
+
+/** USART Baud Rate Get
+ * @brief Reads back the rate actually produced by BRR and OVER8.
+ * @param *USARTx: Which USART peripheral to check.
+ * @retval Baud rate in bits per second.
+ */
+uint32_t usartBaudRateGet(USART_TypeDef* USARTx);
+
+
+/** USART Baud Divisor Compute
+ * @brief Computes the BRR value for a clock, baud rate and oversampling mode.
+ * @param fclk: Peripheral clock in Hz.
+ * @param baud: Requested baud rate in bits per second.
+ * @param over8: 0 for 16x oversampling, 1 for 8x.
+ * @param *errorPpm: Optional, receives the achieved rate error in ppm.
+ * @retval BRR register value, 0 if the rate cannot be generated.
+ *
+ * Pure arithmetic with no register access, so it also builds on a host.
+ */
+uint16_t usartBaudDivisorCompute(uint32_t fclk, uint32_t baud, uint8_t over8,
+        int32_t* errorPpm);
+
+
+/** USART Flow Control Set
+ * @brief Enables hardware RTS and/or CTS handshaking on a running port.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @param flow: Which handshake lines to honour.
+ * @retval 1 for success, 0 if the peripheral is not supported.
+ *
+ * The ctsPin/rtsPin given to usartInit carry the signals. CTS stalls the
+ * transmitter in hardware between characters, so the ring buffer, DMA and
+ * blocking paths are all gated by it. RTS is driven by the receiver: when
+ * polling, it drops whenever a byte sits unread in DR. With circular DMA
+ * receive it drops once half the DMA buffer is unconsumed, by pausing the
+ * DMA so DR stays full, and comes back below a quarter.
+ */
+uint8_t usartFlowControlSet(USART_TypeDef* USARTx, usartFlowControl flow);
+
+
+/** USART RS-485 Enable
+ * @brief Drives a transceiver's DE (and tied RE) pin around every transmit.
+ * @param *USARTx: Which USART peripheral drives the bus.
+ * @param *deGPIO: GPIO port of the driver-enable pin.
+ * @param dePin: Pin number of the driver-enable pin.
+ * @param activeLow: 1 if the transceiver enables its driver on a low level.
+ * @retval 1 for success, 0 if the peripheral is not supported.
+ *
+ * DE is asserted just before the first byte of each transmission on every
+ * send path, blocking, ring buffer and DMA, and released from the TC
+ * interrupt once the last stop bit has left the shift register. No software
+ * delay is needed after a send. Sends made with interrupts masked release
+ * DE once interrupts are enabled again.
+ */
+uint8_t usartRs485Enable(USART_TypeDef* USARTx, GPIO_TypeDef* deGPIO,
+        uint8_t dePin, uint8_t activeLow);
+
+
+/** USART RS-485 Disable
+ * @brief Waits for the line to go quiet, releases DE and stops driving it.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @retval void
+ */
+void usartRs485Disable(USART_TypeDef* USARTx);
+
+
+/** USART Half Duplex Enable
+ * @brief Single-wire mode: TX and RX share the TX pin (HDSEL).
+ * @param *USARTx: Which USART peripheral to configure.
+ * @param *GPIOx: GPIO port of the TX pin given to usartInit.
+ * @param txPin: TX pin number, switched to open-drain with pull-up.
+ * @retval 1 for success, 0 on a bad pin number.
+ *
+ * The receiver hears everything this port transmits, so expect an echo
+ * of each frame before the reply. Add a stronger external pull-up for
+ * higher baud rates or long wires.
+ */
+uint8_t usartHalfDuplexEnable(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx,
+        uint8_t txPin);
+
+
+/** USART Half Duplex Disable
+ * @brief Returns a port to separate TX and RX pins with a push-pull TX.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @param *GPIOx: GPIO port of the TX pin.
+ * @param txPin: TX pin number.
+ * @retval void
+ */
+void usartHalfDuplexDisable(USART_TypeDef* USARTx, GPIO_TypeDef* GPIOx,
+        uint8_t txPin);
+
+
+/** USART Rx Interrupt Enable
+ * @brief Hands every received character to a callback from the interrupt.
+ * @param *USARTx: Which USART peripheral to receive from.
+ * @param callback: Called once per character, in interrupt context.
+ * @retval 1 for success, 0 if unsupported or DMA receive is enabled.
+ *
+ * Meant for protocol drivers that must react to each byte as it lands,
+ * such as LIN. usartRead and usartByteReceive will not see these bytes.
+ */
+uint8_t usartRxInterruptEnable(USART_TypeDef* USARTx,
+        usartRxByteCallback callback);
+
+
+/** USART Rx Interrupt Disable
+ * @brief Stops per-character receive interrupts.
+ * @param *USARTx: Which USART peripheral to stop.
+ * @retval void
+ */
+void usartRxInterruptDisable(USART_TypeDef* USARTx);
+
+
+/** USART LIN Enable
+ * @brief Switches a port to LIN mode (LINEN): 13-bit breaks and break
+ * detection.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @param break11: 1 to detect 11-bit breaks, 0 for 10-bit (LBDL).
+ * @retval void
+ *
+ * LIN needs 8N1 with one stop bit, so stop bits, clock output, smartcard,
+ * IrDA and half-duplex are cleared.
+ */
+void usartLinEnable(USART_TypeDef* USARTx, uint8_t break11);
+
+
+/** USART LIN Disable
+ * @brief Leaves LIN mode.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @retval void
+ */
+void usartLinDisable(USART_TypeDef* USARTx);
+
+
+/** USART Break Send
+ * @brief Queues a break character (SBK) after the current character.
+ * @param *USARTx: Which USART peripheral to send on.
+ * @retval void
+ *
+ * Data written afterwards goes out once the break has finished. In LIN mode
+ * the break is 13 bits long.
+ */
+void usartBreakSend(USART_TypeDef* USARTx);
+
+
+/** USART Multiprocessor Enable
+ * @brief Puts a port on a multi-drop bus, ready for usartMute.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @param wake: Wake method, all nodes on the bus must agree.
+ * @param address: This node's 4-bit address, used by ADDRESS_MARK only.
+ * @retval 1 for success, 0 if address does not fit in 4 bits.
+ *
+ * ADDRESS_MARK switches the port to 9 data bits, with bit 8 flagging an
+ * address byte; parity must stay off. A muted node stays muted through
+ * frames for other addresses and wakes on its own address byte, which is
+ * received as the first byte of the frame. IDLE_LINE keeps 8-bit frames:
+ * every node wakes after an idle line, looks at the first byte itself and
+ * calls usartMute if the frame is not for it. While muted no Rx flag,
+ * interrupt or DMA request is raised, so other nodes' traffic costs nothing.
+ */
+uint8_t usartMultiprocessorEnable(USART_TypeDef* USARTx, usartWakeMode wake,
+        uint8_t address);
+
+
+/** USART Multiprocessor Disable
+ * @brief Returns a port to normal 8-bit reception.
+ * @param *USARTx: Which USART peripheral to configure.
+ * @retval void
+ */
+void usartMultiprocessorDisable(USART_TypeDef* USARTx);
+
+
+/** USART Mute
+ * @brief Mutes the receiver until the next wake event.
+ * @param *USARTx: Which USART peripheral to mute.
+ * @retval 1 if muted, 0 if the hardware refused.
+ *
+ * Call once a frame has been handled, or as soon as it is known to be for
+ * another node. The hardware ignores the request while an unread byte sits
+ * in DR in ADDRESS_MARK mode, and in IDLE_LINE mode before the first byte
+ * has been received.
+ */
+uint8_t usartMute(USART_TypeDef* USARTx);
+
+
+/** USART Address Send
+ * @brief Sends an address byte on an ADDRESS_MARK bus.
+ * @param *USARTx: Which USART peripheral to send on.
+ * @param address: Node address, the low 4 bits are what receivers match.
+ * @retval 1 for success, 0 if the port is not in ADDRESS_MARK mode.
+ *
+ * Anything already queued is sent first. Data bytes that follow go through
+ * the normal send functions and carry bit 8 clear.
+ */
+uint8_t usartAddressSend(USART_TypeDef* USARTx, uint8_t address);
+
+
+/** USART Tx Buffer Enable
+ * @brief Switches a port to interrupt driven transmit through a ring buffer.
+ * @param *USARTx: Which USART peripheral to buffer (USART1, 2 or 6).
+ * @param policy: What to do with new bytes once the ring is full.
+ * @retval 1 for success, 0 if the peripheral is not supported.
+ *
+ * Once enabled, usartByteSend and usartStringSend only copy into the ring and
+ * return; the TXE interrupt feeds the data register and TC marks the line as
+ * idle. usartInit must have been called first.
+ */
+uint8_t usartTxBufferEnable(USART_TypeDef* USARTx, usartTxPolicy policy);
+
+
+/** USART Tx Buffer Disable
+ * @brief Drains the ring, then returns the port to blocking transmit.
+ * @param *USARTx: Which USART peripheral to switch back.
+ */
+void usartTxBufferDisable(USART_TypeDef* USARTx);
+
+
+/** USART Flush
+ * @brief Blocks until every queued byte has left the shift register.
+ * @param *USARTx: Which USART peripheral to flush.
+ */
+void usartFlush(USART_TypeDef* USARTx);
+
+
+/** USART Tx Pending
+ * @brief Number of bytes still waiting in the transmit ring.
+ * @param *USARTx: Which USART peripheral to check.
+ * @retval Queued byte count, 0 for unbuffered ports.
+ */
+uint16_t usartTxPending(USART_TypeDef* USARTx);
+
+
+/** USART DMA Tx Enable
+ * @brief Switches a port to DMA transmit of caller-owned blocks.
+ * @param *USARTx: Which USART peripheral to use (USART1, 2 or 6).
+ * @param callback: Completion callback, may be 0.
+ * @retval 1 for success, 0 if unsupported or the Tx ring buffer is enabled.
+ *
+ * Streams used: USART1 DMA2 Stream7, USART2 DMA1 Stream6, USART6 DMA2
+ * Stream6, all on their datasheet channel. usartInit must be called first.
+ */
+uint8_t usartDmaTxEnable(USART_TypeDef* USARTx, usartDmaTxCallback callback);
+
+
+/** USART DMA Tx Submit
+ * @brief Queues a block for DMA transmit without copying it.
+ * @param *USARTx: Which USART peripheral to send over.
+ * @param *data: Block to send, must stay untouched until its callback.
+ * @param len: Number of bytes in the block, 1 to 65535.
+ * @retval 1 if queued, 0 if both slots are busy or DMA Tx is off.
+ *
+ * Two blocks can be outstanding: one in flight, one waiting. The waiting
+ * block is started from the interrupt as soon as the first completes, so
+ * the caller can fill one buffer while the other is on the wire.
+ */
+uint8_t usartDmaTxSubmit(USART_TypeDef* USARTx, const uint8_t* data,
+        uint16_t len);
+
+
+/** USART DMA Tx Free Slots
+ * @brief Number of blocks usartDmaTxSubmit would accept right now.
+ * @param *USARTx: Which USART peripheral to check.
+ * @retval 0, 1 or 2.
+ *
+ * Safe to spin on with interrupts blocked: a finished block is then retired
+ * by polling the stream flags.
+ */
+uint8_t usartDmaTxFree(USART_TypeDef* USARTx);
+
+
+/** USART DMA Tx Enabled
+ * @brief Whether usartDmaTxEnable is in effect on a port.
+ * @param *USARTx: Which USART peripheral to check.
+ * @retval 1 if transmit goes through usartDmaTxSubmit, 0 otherwise.
+ */
+uint8_t usartDmaTxEnabled(USART_TypeDef* USARTx);
+
+
+/** USART DMA Tx Disable
+ * @brief Waits for outstanding blocks, then returns to blocking transmit.
+ * @param *USARTx: Which USART peripheral to switch back.
+ */
+void usartDmaTxDisable(USART_TypeDef* USARTx);
+
+
+/** USART Stats Get
+ * @brief Copies a consistent snapshot of a port's counters.
+ * @param *USARTx: Which USART peripheral to read.
+ * @param *stats: Destination for the snapshot.
+ * @retval 1 for success, 0 if the peripheral is not supported.
+ */
+uint8_t usartStatsGet(USART_TypeDef* USARTx, usartStats* stats);
+
+
+/** USART Stats Reset
+ * @brief Zeroes a port's counters and peak marks.
+ * @param *USARTx: Which USART peripheral to reset.
+ */
+void usartStatsReset(USART_TypeDef* USARTx);
+
+
+/** USART DMA Tx IRQ Handler
+ * @brief Common service routine for the USART transmit DMA streams.
+ * @param *USARTx: Which USART peripheral the stream belongs to.
+ *
+ * The stream vectors listed under usartDmaTxEnable are defined in usart.c.
+ */
+void usartDmaTxIRQHandler(USART_TypeDef* USARTx);
+
+
+/** USART DMA Rx Enable
+ * @brief Starts circular DMA reception into a caller-owned buffer.
+ * @param *USARTx: Which USART peripheral to use (USART1, 2 or 6).
+ * @param *buffer: Circular receive buffer, owned by the driver until disabled.
+ * @param size: Buffer length in bytes, 2 to 65535.
+ * @param callback: Frame callback, 0 to leave data for usartDmaRxPoll.
+ * @retval 1 for success, 0 if the peripheral is not supported.
+ *
+ * The callback runs on DMA half-transfer, transfer-complete and on the IDLE
+ * line event, so a burst is handed over as soon as the sender pauses for
+ * one character time. Streams used: USART1 DMA2 Stream2, USART2 DMA1
+ * Stream5, USART6 DMA2 Stream1. Keep the USART and its DMA interrupts at
+ * the same priority. The buffer must be large enough to cover the longest
+ * stretch the application leaves data unconsumed.
+ */
+uint8_t usartDmaRxEnable(USART_TypeDef* USARTx, uint8_t* buffer,
+        uint16_t size, usartRxCallback callback);
+
+
+/** USART DMA Rx Disable
+ * @brief Stops circular DMA reception and returns the buffer to the caller.
+ * @param *USARTx: Which USART peripheral to stop.
+ */
+void usartDmaRxDisable(USART_TypeDef* USARTx);
+
+
+/** USART DMA Rx Poll
+ * @brief Hands any pending bytes to the callback from thread context.
+ * @param *USARTx: Which USART peripheral to service.
+ * @retval Number of received bytes still unconsumed in the buffer.
+ */
+uint16_t usartDmaRxPoll(USART_TypeDef* USARTx);
+
+
+/** USART Rx Errors
+ * @brief Returns and clears the receive errors seen since the last call.
+ * @param *USARTx: Which USART peripheral to check.
+ * @retval Mask of USART_SR_ORE, USART_SR_FE, USART_SR_NE and USART_SR_PE.
+ */
+uint16_t usartRxErrors(USART_TypeDef* USARTx);
+
+
+/** USART DMA Rx IRQ Handler
+ * @brief Common service routine for the USART receive DMA streams.
+ * @param *USARTx: Which USART peripheral the stream belongs to.
+ */
+void usartDmaRxIRQHandler(USART_TypeDef* USARTx);
+
+
+/** USART IRQ Handler
+ * @brief Common interrupt service routine for the USART peripherals.
+ * @param *USARTx: Which USART peripheral raised the interrupt.
+ *
+ * USART1_IRQHandler, USART2_IRQHandler and USART6_IRQHandler are defined in
+ * usart.c and call this. Remove them there if the project supplies its own.
+ */
+void usartIRQHandler(USART_TypeDef* USARTx);
+
 #endif /* AMP_USART_H */
@@ -0,0 +1,47 @@
+/**
+ * @file binlog.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Deferred Binary Logging Code for stm32f4xx
+ *
+ * This file contains private and public functions for the binary log
+ * records described in binlog.h. Comes as part of the
+ * stm32f4xx-amperture-periphlib package. The target never touches the
+ * format strings; it only copies the ID and argument words.
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <usart.h>
+#include <timebase.h>
+#include "binlog.h"
+
+//// Public Functions
+
+void binlogWrite(USART_TypeDef* USARTx, uint16_t id, uint8_t nargs, ...){
+    uint8_t record[3 + (4 * BINLOG_MAX_ARGS)];
+    uint8_t len = 3;
+    uint32_t arg;
+    va_list args;
+
+    if(nargs > BINLOG_MAX_ARGS) nargs = BINLOG_MAX_ARGS;
+
+    record[0] = BINLOG_HEADER | nargs;
+    record[1] = (uint8_t)id;
+    record[2] = (uint8_t)(id >> 8);
+
+    va_start(args, nargs);
+    while(nargs--){
+        arg = va_arg(args, uint32_t);
+        record[len++] = (uint8_t)arg;
+        record[len++] = (uint8_t)(arg >> 8);
+        record[len++] = (uint8_t)(arg >> 16);
+        record[len++] = (uint8_t)(arg >> 24);
+    }
+    va_end(args);
+
+    // One write per record keeps records whole on a buffered port.
+    usartWrite(USARTx, record, len, TIMEBASE_WAIT_FOREVER, 0);
+}
@@ -0,0 +1,215 @@
+/**
+ * @file console.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Command Console Code for stm32f4xx
+ *
+ * This file contains private and public functions for the line-edited,
+ * table-driven command console described in console.h. Comes as part of
+ * the stm32f4xx-amperture-periphlib package.
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <string.h>
+#include <usart.h>
+#include "console.h"
+
+// Private Defines
+#define CONSOLE_KEY_CTRL_C  0x03
+#define CONSOLE_KEY_BS      0x08
+#define CONSOLE_KEY_LF      0x0A
+#define CONSOLE_KEY_CR      0x0D
+#define CONSOLE_KEY_CTRL_U  0x15
+#define CONSOLE_KEY_DEL     0x7F
+
+//// Private Functions
+
+static void _consolePuts(console* con, const char* str){
+    usartStringSend(con -> USARTx, (uint8_t*)str);
+}
+
+static void _consolePrompt(console* con){
+    if(con -> prompt) _consolePuts(con, con -> prompt);
+}
+
+static void _consoleUsage(console* con, const consoleCommand* cmd){
+    usartPrintf(con -> USARTx, "usage: %s %s\r\n", cmd -> name,
+            cmd -> usage ? cmd -> usage : "");
+}
+
+static void _consoleHelp(console* con){
+    uint8_t i;
+    const consoleCommand* cmd;
+
+    for(i = 0; i < con -> count; i++){
+        cmd = &(con -> commands[i]);
+        usartPrintf(con -> USARTx, "  %-8s %-16s %s\r\n", cmd -> name,
+                cmd -> usage ? cmd -> usage : "",
+                cmd -> help ? cmd -> help : "");
+    }
+    usartPrintf(con -> USARTx, "  %-8s %-16s %s\r\n", "help", "",
+            "List commands");
+}
+
+// Splits line in place on spaces and tabs.
+static uint8_t _consoleSplit(char* line, char* argv[]){
+    uint8_t argc = 0;
+
+    while(*line){
+        while((*line == ' ') || (*line == '\t')) *line++ = 0;
+        if(*line == 0) break;
+
+        if(argc == CONSOLE_MAX_ARGS) return CONSOLE_MAX_ARGS + 1;
+        argv[argc++] = line;
+
+        while(*line && (*line != ' ') && (*line != '\t')) line++;
+    }
+    return argc;
+}
+
+static void _consoleExecute(console* con){
+    char* argv[CONSOLE_MAX_ARGS];
+    uint8_t argc, i;
+    const consoleCommand* cmd;
+
+    con -> line[con -> len] = 0;
+    argc = _consoleSplit(con -> line, argv);
+
+    if(argc == 0) return;
+    if(argc > CONSOLE_MAX_ARGS){
+        _consolePuts(con, "Too many arguments.\r\n");
+        return;
+    }
+
+    for(i = 0; i < con -> count; i++){
+        cmd = &(con -> commands[i]);
+        if(strcmp(argv[0], cmd -> name) != 0) continue;
+
+        if(((argc - 1) < cmd -> minArgs) || ((argc - 1) > cmd -> maxArgs)
+                || !cmd -> handler(con -> USARTx, argc, argv)){
+            _consoleUsage(con, cmd);
+        }
+        return;
+    }
+
+    if(strcmp(argv[0], "help") == 0){
+        _consoleHelp(con);
+        return;
+    }
+
+    usartPrintf(con -> USARTx, "Unknown command '%s', try help.\r\n",
+            argv[0]);
+}
+
+static void _consoleKey(console* con, uint8_t key){
+    // CR, LF and CR LF all end a line, exactly once.
+    if((key == CONSOLE_KEY_LF) && con -> lastCr){
+        con -> lastCr = 0;
+        return;
+    }
+    con -> lastCr = (key == CONSOLE_KEY_CR);
+
+    switch(key){
+        case CONSOLE_KEY_CR:
+        case CONSOLE_KEY_LF:
+            _consolePuts(con, "\r\n");
+            _consoleExecute(con);
+            con -> len = 0;
+            _consolePrompt(con);
+            break;
+
+        case CONSOLE_KEY_BS:
+        case CONSOLE_KEY_DEL:
+            if(con -> len == 0) break;
+            con -> len--;
+            _consolePuts(con, "\b \b");
+            break;
+
+        case CONSOLE_KEY_CTRL_C:
+            con -> len = 0;
+            _consolePuts(con, "^C\r\n");
+            _consolePrompt(con);
+            break;
+
+        case CONSOLE_KEY_CTRL_U:
+            // Erase the line in place and stay on it.
+            while(con -> len){
+                con -> len--;
+                _consolePuts(con, "\b \b");
+            }
+            break;
+
+        default:
+            // Printable only; escape sequences and other controls are dropped.
+            if((key < ' ') || (key > '~')) break;
+            if(con -> len >= (CONSOLE_LINE_SIZE - 1)) break;
+            con -> line[con -> len++] = key;
+            usartByteSend(con -> USARTx, key);
+            break;
+    }
+}
+
+//// Public Functions
+
+void consoleInit(console* con, USART_TypeDef* USARTx,
+        const consoleCommand* commands, uint8_t count, const char* prompt){
+    con -> USARTx   = USARTx;
+    con -> commands = commands;
+    con -> count    = count;
+    con -> prompt   = prompt;
+    con -> len      = 0;
+    con -> lastCr   = 0;
+
+    _consolePrompt(con);
+}
+
+uint16_t consoleFeed(console* con, const uint8_t* data, uint16_t len){
+    uint16_t i;
+
+    for(i = 0; i < len; i++) _consoleKey(con, data[i]);
+    return len;
+}
+
+uint16_t consolePoll(console* con){
+    uint8_t buf[16];
+    uint16_t got, total = 0;
+
+    do {
+        got = usartRead(con -> USARTx, buf, sizeof(buf), 0, 0);
+        consoleFeed(con, buf, got);
+        total += got;
+    } while(got == sizeof(buf));
+
+    return total;
+}
+
+uint8_t consoleArgToUint(const char* arg, uint32_t* value){
+    uint32_t result = 0;
+    uint32_t base = 10;
+    uint32_t digit;
+
+    if((arg == 0) || (*arg == 0)) return 0;
+
+    if((arg[0] == '0') && ((arg[1] == 'x') || (arg[1] == 'X'))){
+        base = 16;
+        arg += 2;
+        if(*arg == 0) return 0;
+    }
+
+    for(; *arg; arg++){
+        if((*arg >= '0') && (*arg <= '9')) digit = *arg - '0';
+        else if((base == 16) && (*arg >= 'a') && (*arg <= 'f'))
+            digit = *arg - 'a' + 10;
+        else if((base == 16) && (*arg >= 'A') && (*arg <= 'F'))
+            digit = *arg - 'A' + 10;
+        else return 0;
+
+        if(result > ((0xFFFFFFFF - digit) / base)) return 0;
+        result = (result * base) + digit;
+    }
+
+    *value = result;
+    return 1;
+}
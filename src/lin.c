@@ -0,0 +1,380 @@
+/**
+ * @file lin.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief LIN Master Code for stm32f4xx
+ *
+ * This file contains private and public functions for the timer-scheduled
+ * LIN master described in lin.h. Comes as part of the
+ * stm32f4xx-amperture-periphlib package.
+ *
+ * @see LIN Specification Package Revision 2.2A
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <string.h>
+#include <usart.h>
+#include <rcc.h>
+#include "lin.h"
+
+// Private Defines
+#define LIN_SYNC_BYTE           0x55
+#define LIN_ID_DIAG_MASTER      0x3C    // Diagnostic frames use classic.
+#define LIN_ID_DIAG_SLAVE       0x3D
+
+// One master per USART at most.
+#define AMP_LIN_MAX_MASTERS     3
+
+// Private Types
+typedef enum linState {
+    LIN_STATE_IDLE = 0,
+    LIN_STATE_SYNC,         // Waiting for our sync echo, break echo skipped.
+    LIN_STATE_PID,          // Waiting for our PID echo.
+    LIN_STATE_DATA,         // Collecting response and checksum.
+    LIN_STATE_DONE          // Slot outcome already reported.
+} linState;
+
+// Private Variables
+static linMaster* _linMasters[AMP_LIN_MAX_MASTERS];
+
+//// Private Functions
+
+static linMaster* _linMasterGet(USART_TypeDef* USARTx){
+    uint8_t i;
+    for(i = 0; i < AMP_LIN_MAX_MASTERS; i++){
+        if(_linMasters[i] && (_linMasters[i] -> USARTx == USARTx)){
+            return _linMasters[i];
+        }
+    }
+    return 0;
+}
+
+static uint8_t _linChecksumPid(uint8_t id, uint8_t pid){
+    return ((id == LIN_ID_DIAG_MASTER) || (id == LIN_ID_DIAG_SLAVE)) ? 0 : pid;
+}
+
+static void _linFrameFinish(linMaster* lin, linStatus status){
+    const linScheduleEntry* entry = &(lin -> table[lin -> slot]);
+
+    lin -> state = LIN_STATE_DONE;
+    if(status == LIN_OK) lin -> frames++;
+    else lin -> errors++;
+
+    if(lin -> callback) lin -> callback(entry, status);
+}
+
+// Whole response and checksum are in: verify, then publish the result.
+static void _linFrameComplete(linMaster* lin){
+    const linScheduleEntry* entry = &(lin -> table[lin -> slot]);
+    uint8_t sum;
+
+    sum = linChecksum(_linChecksumPid(entry -> id, lin -> pid), lin -> rxBuf,
+            entry -> len);
+    if(lin -> rxBuf[entry -> len] != sum){
+        _linFrameFinish(lin, LIN_ERR_CHECKSUM);
+        return;
+    }
+
+    if(entry -> dir == LIN_PUBLISH){
+        // Our own response came back: any difference is a bus conflict.
+        if(memcmp(lin -> rxBuf, &(lin -> txBuf[2]), entry -> len) != 0){
+            _linFrameFinish(lin, LIN_ERR_READBACK);
+            return;
+        }
+    } else {
+        memcpy(entry -> data, lin -> rxBuf, entry -> len);
+    }
+    _linFrameFinish(lin, LIN_OK);
+}
+
+// Per-character receive, USART interrupt context.
+static void _linRxByte(USART_TypeDef* USARTx, uint16_t data, uint16_t errors){
+    linMaster* lin = _linMasterGet(USARTx);
+
+    if(lin == 0) return;
+
+    switch(lin -> state){
+        case LIN_STATE_SYNC:
+            // The break reads back as 0x00 with a framing error; skip it.
+            if((data == LIN_SYNC_BYTE) && !errors) lin -> state = LIN_STATE_PID;
+            break;
+
+        case LIN_STATE_PID:
+            if(errors || (data != lin -> pid)){
+                _linFrameFinish(lin, LIN_ERR_READBACK);
+            } else {
+                lin -> state = LIN_STATE_DATA;
+            }
+            break;
+
+        case LIN_STATE_DATA:
+            if(errors){
+                _linFrameFinish(lin, LIN_ERR_LINE);
+                break;
+            }
+            lin -> rxBuf[lin -> rxLen++] = data;
+            if(lin -> rxLen == lin -> rxExpected) _linFrameComplete(lin);
+            break;
+
+        default:
+            // Idle or already reported: stray bytes are ignored.
+            break;
+    }
+}
+
+// Sends the break, header and, when publishing, the response of the
+// current slot. Timer interrupt context, or with interrupts masked.
+static void _linFrameStart(linMaster* lin){
+    const linScheduleEntry* entry = &(lin -> table[lin -> slot]);
+    uint8_t n = 0;
+
+    lin -> pid = linPid(entry -> id);
+    lin -> txBuf[n++] = LIN_SYNC_BYTE;
+    lin -> txBuf[n++] = lin -> pid;
+
+    if(entry -> dir == LIN_PUBLISH){
+        memcpy(&(lin -> txBuf[n]), entry -> data, entry -> len);
+        n += entry -> len;
+        lin -> txBuf[n++] = linChecksum(_linChecksumPid(entry -> id,
+                    lin -> pid), entry -> data, entry -> len);
+    }
+
+    lin -> rxLen = 0;
+    lin -> rxExpected = entry -> len + 1;
+    lin -> state = LIN_STATE_SYNC;
+
+    // The sync byte waits in the data register until the break is done.
+    usartBreakSend(lin -> USARTx);
+    usartWrite(lin -> USARTx, lin -> txBuf, n, 0, 0);
+}
+
+// Reports a slot whose response never completed.
+static void _linSlotClose(linMaster* lin){
+    if(lin -> state == LIN_STATE_DONE) return;
+
+    if((lin -> state == LIN_STATE_DATA) && (lin -> rxLen != 0)){
+        _linFrameFinish(lin, LIN_ERR_INCOMPLETE);
+    } else {
+        _linFrameFinish(lin, LIN_ERR_NO_RESPONSE);
+    }
+}
+
+static IRQn_Type _linTimerIrq(TIM_TypeDef* TIMx){
+    if(TIMx == TIM2) return TIM2_IRQn;
+    if(TIMx == TIM3) return TIM3_IRQn;
+    if(TIMx == TIM4) return TIM4_IRQn;
+    return TIM5_IRQn;
+}
+
+static IRQn_Type _linUsartIrq(USART_TypeDef* USARTx){
+    if(USARTx == USART1) return USART1_IRQn;
+    if(USARTx == USART2) return USART2_IRQn;
+    return USART6_IRQn;
+}
+
+static uint8_t _linTimerIs32Bit(TIM_TypeDef* TIMx){
+    return (TIMx == TIM2) || (TIMx == TIM5);
+}
+
+//// Public Functions
+
+uint8_t linPid(uint8_t id){
+    uint8_t p0, p1;
+
+    id &= 0x3F;
+    p0 = ((id >> 0) ^ (id >> 1) ^ (id >> 2) ^ (id >> 4)) & 0x01;
+    p1 = ~((id >> 1) ^ (id >> 3) ^ (id >> 4) ^ (id >> 5)) & 0x01;
+
+    return id | (p0 << 6) | (p1 << 7);
+}
+
+uint8_t linChecksum(uint8_t pid, const uint8_t* data, uint8_t len){
+    uint16_t sum = pid;
+
+    while(len--){
+        sum += *data++;
+        if(sum > 0xFF) sum -= 0xFF;
+    }
+    return (uint8_t)~sum;
+}
+
+uint8_t linMasterInit(linMaster* lin, USART_TypeDef* USARTx,
+        TIM_TypeDef* TIMx, uint32_t baud){
+    uint32_t timclk;
+    uint8_t i, slot = AMP_LIN_MAX_MASTERS;
+    uint8_t reuse = 0;
+
+    if((TIMx != TIM2) && (TIMx != TIM3) && (TIMx != TIM4) && (TIMx != TIM5)){
+        return 0;
+    }
+
+    // A re-init replaces whatever is registered for this master or this
+    // USART, so neither can end up in two slots. Nothing is dropped until
+    // every step that can fail has succeeded.
+    for(i = 0; i < AMP_LIN_MAX_MASTERS; i++){
+        if(_linMasters[i] && (_linMasters[i] -> USARTx == USARTx)) reuse = 1;
+        if((_linMasters[i] == 0) || (_linMasters[i] == lin)
+                || (_linMasters[i] -> USARTx == USARTx)) slot = i;
+    }
+    if(slot == AMP_LIN_MAX_MASTERS) return 0;
+
+    // A USART already running LIN has these on; otherwise undo them if a
+    // later step fails. A rejected baud rate leaves BRR untouched.
+    if(!usartTxBufferEnable(USARTx, USART_TX_POLICY_DROP)) return 0;
+    if(!usartRxInterruptEnable(USARTx, _linRxByte)){
+        if(!reuse) usartTxBufferDisable(USARTx);
+        return 0;
+    }
+    if(!usartBaudRateSet(USARTx, baud, 0)){
+        if(!reuse){
+            usartRxInterruptDisable(USARTx);
+            usartTxBufferDisable(USARTx);
+        }
+        return 0;
+    }
+
+    // Committed: retire the masters being replaced, timers first so no
+    // slot boundary runs on a table that is about to go away.
+    for(i = 0; i < AMP_LIN_MAX_MASTERS; i++){
+        if(_linMasters[i] && ((_linMasters[i] == lin)
+                || (_linMasters[i] -> USARTx == USARTx))){
+            linScheduleStop(_linMasters[i]);
+            _linMasters[i] = 0;
+        }
+    }
+    for(i = 0; i < AMP_LIN_MAX_MASTERS; i++){
+        if(_linMasters[i] == 0){
+            slot = i;
+            break;
+        }
+    }
+
+    memset(lin, 0, sizeof(*lin));
+    lin -> USARTx   = USARTx;
+    lin -> TIMx     = TIMx;
+
+    usartLinEnable(USARTx, 0);
+
+    // TIM2-5 run at PCLK1, doubled whenever APB1 is divided down.
+    timclk = rccPclk1Get();
+    if(timclk != rccHclkGet()) timclk *= 2;
+
+    RCC -> APB1ENR  |=  (1UL << (((uint32_t)TIMx - TIM2_BASE) >> 10));
+    TIMx -> CR1     =   0;
+    TIMx -> CR1     =   (0
+                        | TIM_CR1_URS       // Only overflow raises UIF
+                        | TIM_CR1_ARPE      // Next slot length is preloaded
+                        );
+    TIMx -> PSC     =   (timclk / 1000000) - 1;
+    TIMx -> DIER    =   TIM_DIER_UIE;
+    TIMx -> SR      =   ~(TIM_SR_UIF);
+
+    // Same priority as the USART, so a slot boundary never lands in the
+    // middle of _linRxByte and neither handler sees the other's state
+    // half updated.
+    NVIC_SetPriority(_linTimerIrq(TIMx),
+            NVIC_GetPriority(_linUsartIrq(USARTx)));
+    NVIC_EnableIRQ(_linTimerIrq(TIMx));
+
+    // Only from here on does _linRxByte hand received bytes to this master.
+    _linMasters[slot] = lin;
+    return 1;
+}
+
+uint8_t linScheduleStart(linMaster* lin, const linScheduleEntry* table,
+        uint8_t count, linFrameCallback callback){
+    TIM_TypeDef* TIMx = lin -> TIMx;
+    uint32_t primask;
+    uint8_t i;
+
+    if((table == 0) || (count == 0)) return 0;
+    for(i = 0; i < count; i++){
+        if((table[i].id > 0x3F) || (table[i].len == 0)
+                || (table[i].len > LIN_MAX_DATA) || (table[i].data == 0)
+                || (table[i].slotUs == 0)) return 0;
+        if(!_linTimerIs32Bit(TIMx) && (table[i].slotUs > 0x10000)) return 0;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    lin -> callback = callback;
+
+    if(TIMx -> CR1 & TIM_CR1_CEN){
+        // Running: the timer interrupt switches over at a slot boundary.
+        // Once a switch has been preloaded it can no longer be replaced.
+        if(lin -> switchNext){
+            __set_PRIMASK(primask);
+            return 0;
+        }
+        lin -> pendingTable = table;
+        lin -> pendingCount = count;
+        __set_PRIMASK(primask);
+        return 1;
+    }
+
+    lin -> table        = table;
+    lin -> count        = count;
+    lin -> slot         = 0;
+    lin -> pendingTable = 0;
+    lin -> switchNext   = 0;
+
+    // Load slot 0's length now, then preload slot 1's for the next update.
+    TIMx -> ARR     =   table[0].slotUs - 1;
+    TIMx -> EGR     =   TIM_EGR_UG;
+    TIMx -> ARR     =   table[(count > 1) ? 1 : 0].slotUs - 1;
+    TIMx -> SR      =   ~(TIM_SR_UIF);
+
+    _linFrameStart(lin);
+    TIMx -> CR1     |=  TIM_CR1_CEN;
+
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+void linScheduleStop(linMaster* lin){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    lin -> TIMx -> CR1  &=  ~(TIM_CR1_CEN);
+    lin -> TIMx -> SR   =   ~(TIM_SR_UIF);
+    lin -> state        =   LIN_STATE_IDLE;
+    lin -> pendingTable =   0;
+    lin -> switchNext   =   0;
+
+    __set_PRIMASK(primask);
+}
+
+void linTimerIRQHandler(linMaster* lin){
+    TIM_TypeDef* TIMx = lin -> TIMx;
+    uint8_t next;
+
+    if(!(TIMx -> SR & TIM_SR_UIF)) return;
+    TIMx -> SR = ~(TIM_SR_UIF);
+
+    _linSlotClose(lin);
+
+    // The period that just began was preloaded one update ago.
+    if(lin -> switchNext){
+        lin -> table        = lin -> pendingTable;
+        lin -> count        = lin -> pendingCount;
+        lin -> pendingTable = 0;
+        lin -> switchNext   = 0;
+        lin -> slot         = 0;
+    } else {
+        lin -> slot = ((lin -> slot + 1) < lin -> count) ? lin -> slot + 1 : 0;
+    }
+
+    // Preload the length of the period after this one.
+    if(lin -> pendingTable){
+        TIMx -> ARR = lin -> pendingTable[0].slotUs - 1;
+        lin -> switchNext = 1;
+    } else {
+        next = ((lin -> slot + 1) < lin -> count) ? lin -> slot + 1 : 0;
+        TIMx -> ARR = lin -> table[next].slotUs - 1;
+    }
+
+    _linFrameStart(lin);
+}
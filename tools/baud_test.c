@@ -0,0 +1,168 @@
+/**
+ * @file baud_test.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Host unit test for the USART baud rate divisor
+ *
+ * Checks usartBaudDivisorCompute against hand worked BRR values, and the
+ * 16x/8x oversampling choice made by usartBaudRateSet, with src/usart.c
+ * built for the host against tools/host. Run with `make -C tools test`.
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <usart.h>
+#include "host.h"
+
+// Private Variables
+
+static unsigned _failures;
+
+// Private Defines
+
+#define CHECK_EQ(what, got, want) _checkEq(__LINE__, (what), \
+        (long)(got), (long)(want))
+
+//// Private Functions
+
+static void _checkEq(int line, const char* what, long got, long want){
+    if(got == want) return;
+    printf("baud_test.c:%d: %s = %ld, expected %ld\n", line, what, got, want);
+    _failures++;
+}
+
+// BRR encoding, 16x: mantissa in [15:4], 4-bit fraction in [3:0].
+static void _testOver16(void){
+    int32_t err = 0;
+
+    // 42e6 / 115200 = 364.58 -> 365 = 22 + 13/16.
+    CHECK_EQ("42M/115200 brr",
+            usartBaudDivisorCompute(42000000, 115200, 0, &err), 0x16D);
+    // 42e6 / 365 = 115068 baud.
+    CHECK_EQ("42M/115200 ppm", err, -1145);
+
+    // 84e6 / 115200 = 729.17 -> 729 = 45 + 9/16, 115226 baud.
+    CHECK_EQ("84M/115200 brr",
+            usartBaudDivisorCompute(84000000, 115200, 0, &err), 0x2D9);
+    CHECK_EQ("84M/115200 ppm", err, 225);
+
+    // HSI: 16e6 / 9600 = 1666.67 -> 1667 = 104 + 3/16, 9598 baud.
+    CHECK_EQ("16M/9600 brr",
+            usartBaudDivisorCompute(16000000, 9600, 0, &err), 0x683);
+    CHECK_EQ("16M/9600 ppm", err, -208);
+
+    // Smallest divider, USARTDIV = 1.
+    CHECK_EQ("42M/2.625M brr",
+            usartBaudDivisorCompute(42000000, 2625000, 0, &err), 0x10);
+    CHECK_EQ("42M/2.625M ppm", err, 0);
+
+    // The error pointer is optional.
+    CHECK_EQ("no errorPpm",
+            usartBaudDivisorCompute(42000000, 115200, 0, 0), 0x16D);
+}
+
+// BRR encoding, 8x: the 3-bit fraction stays in [2:0], bit 3 must be 0.
+static void _testOver8(void){
+    int32_t err = 0;
+
+    // 365 = 45 + 5/8 -> mantissa 45 (0x2D) in [15:4], fraction 5.
+    CHECK_EQ("42M/115200 8x brr",
+            usartBaudDivisorCompute(42000000, 115200, 1, &err), 0x2D5);
+    CHECK_EQ("42M/115200 8x ppm", err, -1145);
+
+    // PCLK/8, USARTDIV = 1: 84 MHz -> 10.5 Mbaud, 42 MHz -> 5.25 Mbaud.
+    CHECK_EQ("84M/10.5M 8x brr",
+            usartBaudDivisorCompute(84000000, 10500000, 1, &err), 0x10);
+    CHECK_EQ("84M/10.5M 8x ppm", err, 0);
+    CHECK_EQ("42M/5.25M 8x brr",
+            usartBaudDivisorCompute(42000000, 5250000, 1, &err), 0x10);
+    CHECK_EQ("42M/5.25M 8x ppm", err, 0);
+
+    // 42e6 / 3e6 = 14 = 1 + 6/8.
+    CHECK_EQ("42M/3M 8x brr",
+            usartBaudDivisorCompute(42000000, 3000000, 1, &err), 0x16);
+    CHECK_EQ("42M/3M 8x ppm", err, 0);
+}
+
+static void _testLimits(void){
+    // Faster than PCLK/16 needs 8x, faster than PCLK/8 is impossible.
+    CHECK_EQ("84M/10.5M 16x",
+            usartBaudDivisorCompute(84000000, 10500000, 0, 0), 0);
+    CHECK_EQ("84M/12M 8x",
+            usartBaudDivisorCompute(84000000, 12000000, 1, 0), 0);
+    CHECK_EQ("42M/6M 8x",
+            usartBaudDivisorCompute(42000000, 6000000, 1, 0), 0);
+
+    // Slower than PCLK/65535 overflows the 16x divider, and the 8x one
+    // (12-bit mantissa) gives out at half that.
+    CHECK_EQ("42M/650 16x",
+            usartBaudDivisorCompute(42000000, 650, 0, 0), 0xFC67);
+    CHECK_EQ("42M/600 16x",
+            usartBaudDivisorCompute(42000000, 600, 0, 0), 0);
+    CHECK_EQ("42M/1200 8x",
+            usartBaudDivisorCompute(42000000, 1200, 1, 0), 0);
+
+    CHECK_EQ("baud 0", usartBaudDivisorCompute(42000000, 0, 0, 0), 0);
+    CHECK_EQ("fclk 0", usartBaudDivisorCompute(0, 115200, 0, 0), 0);
+}
+
+// usartBaudRateSet picks 16x unless only 8x can make the rate.
+static void _testModeSwitch(void){
+    int32_t err = 1;
+
+    hostPclk1 = 42000000;
+    hostPclk2 = 84000000;
+
+    USART2 -> CR1 = USART_CR1_OVER8;
+    CHECK_EQ("USART2 115200", usartBaudRateSet(USART2, 115200, &err), 1);
+    CHECK_EQ("USART2 115200 OVER8", USART2 -> CR1 & USART_CR1_OVER8, 0);
+    CHECK_EQ("USART2 115200 BRR", USART2 -> BRR, 0x16D);
+    CHECK_EQ("USART2 115200 ppm", err, -1145);
+    CHECK_EQ("USART2 115200 get", usartBaudRateGet(USART2), 115068);
+
+    CHECK_EQ("USART2 2.625M", usartBaudRateSet(USART2, 2625000, 0), 1);
+    CHECK_EQ("USART2 2.625M OVER8", USART2 -> CR1 & USART_CR1_OVER8, 0);
+
+    CHECK_EQ("USART2 3M", usartBaudRateSet(USART2, 3000000, &err), 1);
+    CHECK_EQ("USART2 3M OVER8", USART2 -> CR1 & USART_CR1_OVER8,
+            USART_CR1_OVER8);
+    CHECK_EQ("USART2 3M BRR", USART2 -> BRR, 0x16);
+    CHECK_EQ("USART2 3M get", usartBaudRateGet(USART2), 3000000);
+
+    CHECK_EQ("USART2 5.25M", usartBaudRateSet(USART2, 5250000, &err), 1);
+    CHECK_EQ("USART2 5.25M BRR", USART2 -> BRR, 0x10);
+    CHECK_EQ("USART2 5.25M get", usartBaudRateGet(USART2), 5250000);
+
+    // USART1 is on APB2, twice as fast.
+    CHECK_EQ("USART1 10.5M", usartBaudRateSet(USART1, 10500000, &err), 1);
+    CHECK_EQ("USART1 10.5M OVER8", USART1 -> CR1 & USART_CR1_OVER8,
+            USART_CR1_OVER8);
+    CHECK_EQ("USART1 10.5M BRR", USART1 -> BRR, 0x10);
+    CHECK_EQ("USART1 10.5M ppm", err, 0);
+
+    // A rejected rate leaves the previous setting alone.
+    CHECK_EQ("USART2 10.5M", usartBaudRateSet(USART2, 10500000, 0), 0);
+    CHECK_EQ("USART2 10.5M BRR", USART2 -> BRR, 0x10);
+    CHECK_EQ("USART2 10.5M OVER8", USART2 -> CR1 & USART_CR1_OVER8,
+            USART_CR1_OVER8);
+    CHECK_EQ("USART2 600", usartBaudRateSet(USART2, 600, 0), 0);
+    CHECK_EQ("USART2 600 BRR", USART2 -> BRR, 0x10);
+}
+
+//// Public Functions
+
+int main(void){
+    _testOver16();
+    _testOver8();
+    _testLimits();
+    _testModeSwitch();
+
+    if(_failures){
+        printf("baud_test: %u failure(s)\n", _failures);
+        return 1;
+    }
+    printf("baud_test: OK\n");
+    return 0;
+}
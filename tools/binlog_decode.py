@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""
+binlog_decode.py
+Amperture Engineering, http://www.amperture.com
+Modified BSD License
+
+Host side decoder for the BINLOG records produced by src/binlog.c, part of
+the stm32f4xx-amperture-periphlib package.
+
+The format strings never leave the host: they are read out of the .binlog
+section of the firmware ELF, looked up by the 16-bit ID in each record and
+formatted here.
+
+Usage:
+    binlog_decode.py firmware.elf [capture]
+
+capture is a file or serial device holding the raw byte stream; stdin is
+used when it is omitted. Configure a serial device first, for example
+`stty -F /dev/ttyACM0 115200 raw -echo`.
+"""
+
+import re
+import struct
+import sys
+
+BINLOG_HEADER = 0xC0
+BINLOG_MAX_ARGS = 8
+
+# printf conversions the target can send, all as 32-bit words.
+CONVERSION = re.compile(r"%([-0]?)(\d*)l*([udixXc%])")
+
+
+def load_strings(elf_path):
+    """Returns (data, base) of the .binlog section of a 32-bit LE ELF."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        sys.exit("%s: not a 32-bit little-endian ELF" % elf_path)
+
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def section(index):
+        return struct.unpack_from("<IIIIII", elf, shoff + index * shentsize)
+
+    names = section(shstrndx)
+    for i in range(shnum):
+        name, _, _, addr, offset, size = section(i)
+        end = elf.index(b"\0", names[4] + name)
+        if elf[names[4] + name:end] == b".binlog":
+            return elf[offset:offset + size], addr
+
+    sys.exit("%s: no .binlog section; no BINLOG() statements were compiled "
+             "into this firmware, so there is nothing to decode" % elf_path)
+
+
+def format_record(fmt, args):
+    """Applies C printf semantics for the supported integer conversions."""
+    args = list(args)
+
+    def convert(match):
+        flag, width, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if conv in "di" and value & 0x80000000:
+            value -= 1 << 32
+        if conv == "c":
+            return ("%" + flag + width + "c") % chr(value & 0xFF)
+        pyconv = "d" if conv in "udi" else conv
+        return ("%" + flag + width + pyconv) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def string_starts(strings):
+    """Returns the offsets of every format string in the .binlog section."""
+    starts = set()
+    start = 0
+    for end, byte in enumerate(strings):
+        if byte == 0:
+            if end > start:
+                starts.add(start)
+            start = end + 1
+    return starts
+
+
+def decode(stream, strings, base, out):
+    """Reads records from stream forever, resyncing on bad records.
+
+    A record is only accepted when its ID points at the start of a format
+    string. Anything else, including an ID landing in the middle of one, is
+    treated as lost sync: the header byte is dropped and the search resumes
+    on the byte after it.
+    """
+    starts = string_starts(strings)
+    pending = bytearray()
+
+    def fill(size):
+        while len(pending) < size:
+            data = stream.read(size - len(pending))
+            if not data:
+                return False
+            pending.extend(data)
+        return True
+
+    while True:
+        if not fill(1):
+            return
+        nargs = pending[0] & 0x0F
+        if (pending[0] & 0xF0) != BINLOG_HEADER or nargs > BINLOG_MAX_ARGS:
+            del pending[0]
+            continue
+
+        size = 3 + 4 * nargs
+        if not fill(size):
+            return
+        ident, = struct.unpack_from("<H", pending, 1)
+
+        # IDs are the low 16 bits of the string address, see inc/binlog.h.
+        offset = (ident - base) & 0xFFFF
+        if offset not in starts:
+            del pending[0]
+            continue
+
+        args = struct.unpack_from("<%dI" % nargs, pending, 3)
+        del pending[:size]
+        end = strings.index(b"\0", offset)
+        fmt = strings[offset:end].decode("ascii", "replace")
+        out.write(format_record(fmt, args))
+        out.flush()
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.exit(__doc__)
+
+    strings, base = load_strings(argv[1])
+    if len(argv) == 3:
+        with open(argv[2], "rb", buffering=0) as stream:
+            decode(stream, strings, base, sys.stdout)
+    else:
+        decode(sys.stdin.buffer, strings, base, sys.stdout)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
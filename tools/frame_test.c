@@ -0,0 +1,261 @@
+/**
+ * @file frame_test.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Host unit test for the COBS framing layer
+ *
+ * Runs frames from frameEncode and frameWrite back through frameRxFeed and
+ * checks the payloads, the CRC and sequence counters, and that frameWrite
+ * hands its own buffers to the DMA stream in turn. src/frame.c and
+ * src/usart.c are built for the host against tools/host. Run with
+ * `make -C tools test`.
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <usart.h>
+#include <frame.h>
+#include "host.h"
+
+// Private Variables
+
+static unsigned _failures;
+
+// What the decoder delivered last, and how often.
+static uint32_t _rxCalls;
+static uint8_t  _rxSeq;
+static uint16_t _rxLen;
+static uint8_t  _rxPayload[FRAME_MAX_PAYLOAD];
+
+// Private Defines
+
+#define CHECK_EQ(what, got, want) _checkEq(__LINE__, (what), \
+        (long)(got), (long)(want))
+
+// USART2's Tx stream is DMA1 Stream6, its TCIF bit sits at 21 in HISR.
+#define TEST_DMA_TC6 ((uint32_t)0x20 << 16)
+
+//// Private Functions
+
+static void _checkEq(int line, const char* what, long got, long want){
+    if(got == want) return;
+    printf("frame_test.c:%d: %s = %ld, expected %ld\n", line, what, got, want);
+    _failures++;
+}
+
+static void _rxCallback(uint8_t seq, const uint8_t* payload, uint16_t len){
+    _rxCalls++;
+    _rxSeq = seq;
+    _rxLen = len;
+    memcpy(_rxPayload, payload, len);
+}
+
+// Delimiter only at the end, so a receiver can always resync.
+static uint8_t _zeroOnlyAtEnd(const uint8_t* frame, uint16_t len){
+    uint16_t i;
+    for(i = 0; i + 1 < len; i++){
+        if(frame[i] == 0x00) return 0;
+    }
+    return (len != 0) && (frame[len - 1] == 0x00);
+}
+
+// Encodes, feeds one byte at a time and checks the payload comes back.
+static void _roundTrip(const char* what, uint8_t seq, const uint8_t* payload,
+        uint16_t len){
+    uint8_t frame[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+    frameRx rx;
+    uint16_t encoded, i;
+
+    frameRxInit(&rx, _rxCallback);
+    _rxCalls = 0;
+
+    encoded = frameEncode(frame, sizeof(frame), seq, payload, len);
+    if(encoded == 0 || encoded > FRAME_ENCODED_MAX(len)){
+        CHECK_EQ(what, encoded, FRAME_ENCODED_MAX(len));
+        return;
+    }
+    CHECK_EQ(what, _zeroOnlyAtEnd(frame, encoded), 1);
+
+    for(i = 0; i < encoded; i++) frameRxFeed(&rx, &frame[i], 1);
+
+    CHECK_EQ(what, _rxCalls, 1);
+    CHECK_EQ(what, rx.frames, 1);
+    CHECK_EQ(what, rx.crcErrors, 0);
+    CHECK_EQ(what, _rxSeq, seq);
+    CHECK_EQ(what, _rxLen, len);
+    CHECK_EQ(what, memcmp(_rxPayload, payload, len), 0);
+}
+
+static void _testRoundTrip(void){
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint16_t i;
+
+    memset(payload, 0, sizeof(payload));
+    _roundTrip("empty", 0x00, payload, 0);
+    _roundTrip("zeros", 0x00, payload, 3);
+    _roundTrip("256 zeros", 0x7F, payload, FRAME_MAX_PAYLOAD);
+
+    // No zeros at all: full 254-byte COBS blocks with no implied zero.
+    for(i = 0; i < FRAME_MAX_PAYLOAD; i++) payload[i] = (uint8_t)(1 + i % 255);
+    _roundTrip("254 data bytes", 0x01, payload, 251);
+    _roundTrip("255 data bytes", 0x01, payload, 252);
+    _roundTrip("256 no zeros", 0xFF, payload, FRAME_MAX_PAYLOAD);
+
+    // Zeros either side of the 254-byte block boundary.
+    for(i = 0; i < FRAME_MAX_PAYLOAD; i++) payload[i] = (uint8_t)(i * 7);
+    payload[252] = 0x00;
+    payload[253] = 0x00;
+    _roundTrip("256 mixed", 0x80, payload, FRAME_MAX_PAYLOAD);
+}
+
+// A damaged frame is counted and dropped, the next one still decodes.
+static void _testCrcError(void){
+    const uint8_t payload[] = { 0x10, 0x00, 0x20, 0x30, 0x00, 0x40 };
+    uint8_t frame[FRAME_ENCODED_MAX(sizeof(payload))];
+    uint8_t good[FRAME_ENCODED_MAX(sizeof(payload))];
+    frameRx rx;
+    uint16_t encoded;
+
+    frameRxInit(&rx, _rxCallback);
+    _rxCalls = 0;
+
+    encoded = frameEncode(good, sizeof(good), 1, payload, sizeof(payload));
+    memcpy(frame, good, encoded);
+
+    // Flip a data bit without making a new zero.
+    frame[encoded / 2] ^= (frame[encoded / 2] == 0x01) ? 0x02 : 0x01;
+    frameRxFeed(&rx, frame, encoded);
+    CHECK_EQ("bad crc calls", _rxCalls, 0);
+    CHECK_EQ("bad crc crcErrors", rx.crcErrors, 1);
+    CHECK_EQ("bad crc frames", rx.frames, 0);
+
+    // The delimiter is lost: the garbage and the next frame merge and fail,
+    // then the receiver is back in step.
+    frameRxFeed(&rx, good, encoded - 1);
+    frameRxFeed(&rx, good, encoded);
+    CHECK_EQ("lost delimiter crcErrors", rx.crcErrors, 2);
+    frameRxFeed(&rx, good, encoded);
+    CHECK_EQ("resync calls", _rxCalls, 1);
+    CHECK_EQ("resync frames", rx.frames, 1);
+    CHECK_EQ("resync len", _rxLen, sizeof(payload));
+
+    // Too short to hold seq and CRC.
+    frameRxFeed(&rx, (const uint8_t*)"\x02\x05\x00", 3);
+    CHECK_EQ("runt crcErrors", rx.crcErrors, 3);
+}
+
+// Each gap counts once, however many frames went missing in it.
+static void _testSequenceGap(void){
+    const uint8_t seqs[] = { 250, 251, 253, 254, 255, 0, 9, 10 };
+    const uint8_t payload[] = { 0xA5 };
+    uint8_t frame[FRAME_ENCODED_MAX(sizeof(payload))];
+    frameRx rx;
+    uint16_t encoded;
+    uint8_t i;
+
+    frameRxInit(&rx, _rxCallback);
+
+    for(i = 0; i < sizeof(seqs); i++){
+        encoded = frameEncode(frame, sizeof(frame), seqs[i], payload,
+                sizeof(payload));
+        frameRxFeed(&rx, frame, encoded);
+    }
+    CHECK_EQ("gap frames", rx.frames, sizeof(seqs));
+    CHECK_EQ("gap lost", rx.lost, 2);
+    CHECK_EQ("gap crcErrors", rx.crcErrors, 0);
+}
+
+static void _testLimits(void){
+    uint8_t payload[FRAME_MAX_PAYLOAD + 1] = { 0 };
+    uint8_t frame[FRAME_ENCODED_MAX(4)];
+    frameTx tx;
+
+    memset(&tx, 0, sizeof(tx));
+    CHECK_EQ("small out", frameEncode(frame, FRAME_ENCODED_MAX(4) - 1, 0,
+                payload, 4), 0);
+    CHECK_EQ("fits out", frameEncode(frame, sizeof(frame), 0, payload, 4),
+            FRAME_ENCODED_MAX(4));
+    CHECK_EQ("oversize write",
+            frameWrite(USART2, &tx, payload, FRAME_MAX_PAYLOAD + 1), 0);
+    CHECK_EQ("oversize seq", tx.seq, 0);
+}
+
+// Stand-in for the DMA finishing the block on the wire.
+static void _dmaTxComplete(void){
+    DMA1 -> HISR = TEST_DMA_TC6;
+    usartDmaTxIRQHandler(USART2);
+    DMA1 -> HISR = 0;
+}
+
+// frameWrite submits its own buffers, alternating, and never overwrites
+// one still queued.
+static void _testWriteDma(void){
+    const uint8_t payload[] = { 0x00, 0x11, 0x22 };
+    DMA_Stream_TypeDef* stream = DMA1_Stream6;
+    frameTx tx;
+    frameRx rx;
+
+    memset(&tx, 0, sizeof(tx));
+    frameRxInit(&rx, _rxCallback);
+
+    USART2 -> SR = USART_SR_TXE | USART_SR_TC;
+    CHECK_EQ("dma enable", usartDmaTxEnable(USART2, 0), 1);
+
+    CHECK_EQ("write 0", frameWrite(USART2, &tx, payload, sizeof(payload)), 1);
+    CHECK_EQ("write 0 M0AR", stream -> M0AR, (uint32_t)(uintptr_t)tx.buf[0]);
+    CHECK_EQ("write 0 NDTR", stream -> NDTR,
+            FRAME_ENCODED_MAX(sizeof(payload)));
+
+    CHECK_EQ("write 1", frameWrite(USART2, &tx, payload, sizeof(payload)), 1);
+    CHECK_EQ("queue full", usartDmaTxFree(USART2), 0);
+    CHECK_EQ("write 1 waits", stream -> M0AR,
+            (uint32_t)(uintptr_t)tx.buf[0]);
+
+    frameRxFeed(&rx, tx.buf[0], FRAME_ENCODED_MAX(sizeof(payload)));
+    _dmaTxComplete();
+    CHECK_EQ("write 1 M0AR", stream -> M0AR, (uint32_t)(uintptr_t)tx.buf[1]);
+    CHECK_EQ("one free", usartDmaTxFree(USART2), 1);
+
+    // Buffer 0 is free again and takes the next frame.
+    CHECK_EQ("write 2", frameWrite(USART2, &tx, payload, sizeof(payload)), 1);
+    frameRxFeed(&rx, tx.buf[1], FRAME_ENCODED_MAX(sizeof(payload)));
+    _dmaTxComplete();
+    CHECK_EQ("write 2 M0AR", stream -> M0AR, (uint32_t)(uintptr_t)tx.buf[0]);
+    frameRxFeed(&rx, tx.buf[0], FRAME_ENCODED_MAX(sizeof(payload)));
+
+    // With interrupts blocked the wait polls the stream flags itself.
+    CHECK_EQ("write 3", frameWrite(USART2, &tx, payload, sizeof(payload)), 1);
+    frameRxFeed(&rx, tx.buf[1], FRAME_ENCODED_MAX(sizeof(payload)));
+    __set_PRIMASK(1);
+    DMA1 -> HISR = TEST_DMA_TC6;
+    CHECK_EQ("write 4", frameWrite(USART2, &tx, payload, sizeof(payload)), 1);
+    DMA1 -> HISR = 0;
+    __set_PRIMASK(0);
+    CHECK_EQ("write 4 M0AR", stream -> M0AR, (uint32_t)(uintptr_t)tx.buf[1]);
+
+    frameRxFeed(&rx, tx.buf[0], FRAME_ENCODED_MAX(sizeof(payload)));
+    CHECK_EQ("dma frames", rx.frames, 5);
+    CHECK_EQ("dma lost", rx.lost, 0);
+    CHECK_EQ("dma seq", _rxSeq, 4);
+    CHECK_EQ("dma payload", memcmp(_rxPayload, payload, sizeof(payload)), 0);
+}
+
+//// Public Functions
+
+int main(void){
+    _testRoundTrip();
+    _testCrcError();
+    _testSequenceGap();
+    _testLimits();
+    _testWriteDma();
+
+    if(_failures){
+        printf("frame_test: %u failure(s)\n", _failures);
+        return 1;
+    }
+    printf("frame_test: OK\n");
+    return 0;
+}
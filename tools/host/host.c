@@ -0,0 +1,62 @@
+/**
+ * @file host.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Host stand-ins for peripherals, CMSIS core, rcc and timebase
+ *
+ * Linked with the driver sources into the programs in tools/. Interrupts
+ * are never taken, the cycle counter never moves and timeouts never expire,
+ * so anything that would wait on hardware must be preset by the caller.
+ */
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+#include <rcc.h>
+#include <timebase.h>
+#include "host.h"
+
+// Peripherals
+
+USART_TypeDef       hostUSART1, hostUSART2, hostUSART6;
+GPIO_TypeDef        hostGPIOA, hostGPIOB;
+DMA_TypeDef         hostDMA1, hostDMA2;
+DMA_Stream_TypeDef  hostDMA1_Stream5, hostDMA1_Stream6;
+DMA_Stream_TypeDef  hostDMA2_Stream1, hostDMA2_Stream2;
+DMA_Stream_TypeDef  hostDMA2_Stream6, hostDMA2_Stream7;
+RCC_TypeDef         hostRCC;
+
+uint32_t hostPclk1 = 42000000;
+uint32_t hostPclk2 = 84000000;
+
+static uint32_t _hostPrimask;
+
+// CMSIS core
+
+void NVIC_EnableIRQ(IRQn_Type IRQn){ (void)IRQn; }
+void NVIC_DisableIRQ(IRQn_Type IRQn){ (void)IRQn; }
+uint32_t __get_PRIMASK(void){ return _hostPrimask; }
+void __set_PRIMASK(uint32_t priMask){ _hostPrimask = priMask; }
+uint32_t __get_IPSR(void){ return 0; }
+void __disable_irq(void){ _hostPrimask = 1; }
+
+// rcc
+
+uint32_t rccSysclkGet(void){ return hostPclk2; }
+uint32_t rccHclkGet(void){ return hostPclk2; }
+uint32_t rccPclk1Get(void){ return hostPclk1; }
+uint32_t rccPclk2Get(void){ return hostPclk2; }
+
+// timebase
+
+void timebaseInit(void){}
+uint32_t timebaseCyclesGet(void){ return 0; }
+
+uint8_t timebaseExpired(uint32_t start, uint32_t timeoutUs){
+    (void)start;
+    (void)timeoutUs;
+    return 0;
+}
+
+uint32_t timebaseCyclesToUs(uint32_t cycles){ return cycles; }
+void timebaseDelayUs(uint32_t us){ (void)us; }
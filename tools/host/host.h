@@ -0,0 +1,15 @@
+/**
+ * @file host.h
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Knobs for the host stand-ins in host.c
+ */
+#ifndef AMP_HOST_H
+#define AMP_HOST_H
+
+// Clocks reported by rccPclk1Get (USART2) and rccPclk2Get (USART1/6).
+extern uint32_t hostPclk1;
+extern uint32_t hostPclk2;
+
+#endif
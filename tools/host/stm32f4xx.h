@@ -0,0 +1,201 @@
+/**
+ * @file stm32f4xx.h
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Host stand-in for the CMSIS device header
+ *
+ * Lets the driver sources build and run on a PC for the programs in tools/.
+ * Only what src/usart.c and the headers it pulls in use is declared. Each
+ * peripheral is a plain struct in RAM, defined in host.c, so a test can
+ * preset status flags and read back what the driver wrote. The CMSIS core
+ * intrinsics, rcc and timebase are stubbed out in host.c as well.
+ *
+ * Never put this directory on the include path of a firmware build.
+ */
+#ifndef AMP_HOST_STM32F4XX_H
+#define AMP_HOST_STM32F4XX_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {
+    DMA1_Stream5_IRQn   = 16,
+    DMA1_Stream6_IRQn   = 17,
+    USART1_IRQn         = 37,
+    USART2_IRQn         = 38,
+    DMA2_Stream1_IRQn   = 57,
+    DMA2_Stream2_IRQn   = 58,
+    DMA2_Stream6_IRQn   = 69,
+    DMA2_Stream7_IRQn   = 70,
+    USART6_IRQn         = 71,
+} IRQn_Type;
+
+// Register blocks, same layout as the device header.
+
+typedef struct {
+    __IO uint16_t SR;       uint16_t RESERVED0;
+    __IO uint16_t DR;       uint16_t RESERVED1;
+    __IO uint16_t BRR;      uint16_t RESERVED2;
+    __IO uint16_t CR1;      uint16_t RESERVED3;
+    __IO uint16_t CR2;      uint16_t RESERVED4;
+    __IO uint16_t CR3;      uint16_t RESERVED5;
+    __IO uint16_t GTPR;     uint16_t RESERVED6;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint16_t BSRRL;
+    __IO uint16_t BSRRH;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t NDTR;
+    __IO uint32_t PAR;
+    __IO uint32_t M0AR;
+    __IO uint32_t M1AR;
+    __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t LISR;
+    __IO uint32_t HISR;
+    __IO uint32_t LIFCR;
+    __IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t PLLCFGR;
+    __IO uint32_t CFGR;
+    __IO uint32_t CIR;
+    __IO uint32_t AHB1RSTR;
+    __IO uint32_t AHB2RSTR;
+    uint32_t      RESERVED0[2];
+    __IO uint32_t APB1RSTR;
+    __IO uint32_t APB2RSTR;
+    uint32_t      RESERVED1[2];
+    __IO uint32_t AHB1ENR;
+    __IO uint32_t AHB2ENR;
+    uint32_t      RESERVED2[2];
+    __IO uint32_t APB1ENR;
+    __IO uint32_t APB2ENR;
+} RCC_TypeDef;
+
+// Peripheral instances, see host.c. GPIOA_BASE keeps the "GPIOx - GPIOA_BASE"
+// clock enable arithmetic in range; its result is never used on the host.
+
+extern USART_TypeDef        hostUSART1, hostUSART2, hostUSART6;
+extern GPIO_TypeDef         hostGPIOA, hostGPIOB;
+extern DMA_TypeDef          hostDMA1, hostDMA2;
+extern DMA_Stream_TypeDef   hostDMA1_Stream5, hostDMA1_Stream6;
+extern DMA_Stream_TypeDef   hostDMA2_Stream1, hostDMA2_Stream2;
+extern DMA_Stream_TypeDef   hostDMA2_Stream6, hostDMA2_Stream7;
+extern RCC_TypeDef          hostRCC;
+
+#define USART1          (&hostUSART1)
+#define USART2          (&hostUSART2)
+#define USART6          (&hostUSART6)
+#define GPIOA           (&hostGPIOA)
+#define GPIOB           (&hostGPIOB)
+#define GPIOA_BASE      ((uint32_t)(uintptr_t)GPIOA)
+#define DMA1            (&hostDMA1)
+#define DMA2            (&hostDMA2)
+#define DMA1_Stream5    (&hostDMA1_Stream5)
+#define DMA1_Stream6    (&hostDMA1_Stream6)
+#define DMA2_Stream1    (&hostDMA2_Stream1)
+#define DMA2_Stream2    (&hostDMA2_Stream2)
+#define DMA2_Stream6    (&hostDMA2_Stream6)
+#define DMA2_Stream7    (&hostDMA2_Stream7)
+#define RCC             (&hostRCC)
+
+// CMSIS core
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+uint32_t __get_IPSR(void);
+void __disable_irq(void);
+
+// Bit definitions
+
+#define USART_SR_PE             ((uint16_t)0x0001)
+#define USART_SR_FE             ((uint16_t)0x0002)
+#define USART_SR_NE             ((uint16_t)0x0004)
+#define USART_SR_ORE            ((uint16_t)0x0008)
+#define USART_SR_IDLE           ((uint16_t)0x0010)
+#define USART_SR_RXNE           ((uint16_t)0x0020)
+#define USART_SR_TC             ((uint16_t)0x0040)
+#define USART_SR_TXE            ((uint16_t)0x0080)
+
+#define USART_BRR_DIV_Mantissa  ((uint16_t)0xFFF0)
+
+#define USART_CR1_SBK           ((uint16_t)0x0001)
+#define USART_CR1_RWU           ((uint16_t)0x0002)
+#define USART_CR1_RE            ((uint16_t)0x0004)
+#define USART_CR1_TE            ((uint16_t)0x0008)
+#define USART_CR1_IDLEIE        ((uint16_t)0x0010)
+#define USART_CR1_RXNEIE        ((uint16_t)0x0020)
+#define USART_CR1_TCIE          ((uint16_t)0x0040)
+#define USART_CR1_TXEIE         ((uint16_t)0x0080)
+#define USART_CR1_PEIE          ((uint16_t)0x0100)
+#define USART_CR1_PS            ((uint16_t)0x0200)
+#define USART_CR1_PCE           ((uint16_t)0x0400)
+#define USART_CR1_WAKE          ((uint16_t)0x0800)
+#define USART_CR1_M             ((uint16_t)0x1000)
+#define USART_CR1_UE            ((uint16_t)0x2000)
+#define USART_CR1_OVER8         ((uint16_t)0x8000)
+
+#define USART_CR2_ADD           ((uint16_t)0x000F)
+#define USART_CR2_LBDL          ((uint16_t)0x0020)
+#define USART_CR2_LBDIE         ((uint16_t)0x0040)
+#define USART_CR2_LBCL          ((uint16_t)0x0100)
+#define USART_CR2_CPHA          ((uint16_t)0x0200)
+#define USART_CR2_CPOL          ((uint16_t)0x0400)
+#define USART_CR2_CLKEN         ((uint16_t)0x0800)
+#define USART_CR2_STOP          ((uint16_t)0x3000)
+#define USART_CR2_LINEN         ((uint16_t)0x4000)
+
+#define USART_CR3_EIE           ((uint16_t)0x0001)
+#define USART_CR3_IREN          ((uint16_t)0x0002)
+#define USART_CR3_IRLP          ((uint16_t)0x0004)
+#define USART_CR3_HDSEL         ((uint16_t)0x0008)
+#define USART_CR3_NACK          ((uint16_t)0x0010)
+#define USART_CR3_SCEN          ((uint16_t)0x0020)
+#define USART_CR3_DMAR          ((uint16_t)0x0040)
+#define USART_CR3_DMAT          ((uint16_t)0x0080)
+#define USART_CR3_RTSE          ((uint16_t)0x0100)
+#define USART_CR3_CTSE          ((uint16_t)0x0200)
+#define USART_CR3_CTSIE         ((uint16_t)0x0400)
+#define USART_CR3_ONEBIT        ((uint16_t)0x0800)
+
+#define USART_GTPR_PSC          ((uint16_t)0x00FF)
+#define USART_GTPR_GT           ((uint16_t)0xFF00)
+
+#define RCC_AHB1ENR_DMA1EN      ((uint32_t)0x00200000)
+#define RCC_AHB1ENR_DMA2EN      ((uint32_t)0x00400000)
+#define RCC_APB1ENR_USART2EN    ((uint32_t)0x00020000)
+#define RCC_APB2ENR_USART1EN    ((uint32_t)0x00000010)
+#define RCC_APB2ENR_USART6EN    ((uint32_t)0x00000020)
+
+#define DMA_SxCR_EN             ((uint32_t)0x00000001)
+#define DMA_SxCR_DMEIE          ((uint32_t)0x00000002)
+#define DMA_SxCR_TEIE           ((uint32_t)0x00000004)
+#define DMA_SxCR_HTIE           ((uint32_t)0x00000008)
+#define DMA_SxCR_TCIE           ((uint32_t)0x00000010)
+#define DMA_SxCR_DIR_0          ((uint32_t)0x00000040)
+#define DMA_SxCR_CIRC           ((uint32_t)0x00000100)
+#define DMA_SxCR_MINC           ((uint32_t)0x00000400)
+#define DMA_SxCR_PL_0           ((uint32_t)0x00010000)
+
+#endif
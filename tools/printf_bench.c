@@ -0,0 +1,249 @@
+/**
+ * @file printf_bench.c
+ * @author W. Alex Best
+ * @website http://www.amperture.com
+ * @date 17 Oct 2026
+ * @brief Host benchmark of usartPrintf against the old itoa path
+ *
+ * Times the printDateInfo and i2cStatePrint lines of the DS3231 example
+ * both ways: the single usartPrintf call they use now, and the itoa plus
+ * usartStringSend sequence they replaced. The bare number conversions,
+ * _usartFmtDec and _usartFmtHex against itoa, are timed on their own too.
+ *
+ * src/usart.c is included rather than linked so its static formatter
+ * helpers can be called. USART2 is the RAM stand-in from tools/host with
+ * TXE held set, so only CPU time is measured, never the wire. Absolute
+ * figures are for the host CPU; the ratios are what carry over to the
+ * Cortex-M4. Run with `make -C tools bench`.
+ */
+
+#include "../src/usart.c"
+#include <stdio.h>
+#include <time.h>
+
+// Private Types
+
+// Same fields as ds3231Date, without pulling in the I2C driver.
+typedef struct benchDate {
+    uint8_t dayOfWeek;
+    uint8_t dayOfMonth;
+    uint8_t month;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t year;
+} benchDate;
+
+// Private Defines
+
+#define BENCH_LINES         200000
+#define BENCH_CONVERSIONS   5000000
+
+// Private Variables
+
+static volatile uint32_t _benchSink;
+
+//// Private Functions
+
+// newlib's itoa/__utoa, which the example linked against before.
+static char* __attribute__((noinline)) _benchItoa(int value, char* str,
+        int base){
+    const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    unsigned uvalue;
+    int i = 0, j;
+    char c;
+
+    if((base < 2) || (base > 36)){
+        str[0] = '\0';
+        return 0;
+    }
+    if((base == 10) && (value < 0)){
+        str[i++] = '-';
+        uvalue = (unsigned)-value;
+    } else {
+        uvalue = (unsigned)value;
+    }
+
+    str += i;
+    i = 0;
+    do {
+        str[i++] = digits[uvalue % base];
+        uvalue /= base;
+    } while(uvalue != 0);
+    str[i] = '\0';
+
+    for(j = 0, i--; j < i; j++, i--){
+        c = str[j];
+        str[j] = str[i];
+        str[i] = c;
+    }
+    return str;
+}
+
+static double _benchNow(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void _benchDateGet(benchDate* date, uint32_t n){
+    date -> second      = n % 60;
+    date -> minute      = (n / 60) % 60;
+    date -> hour        = (n / 3600) % 24;
+    date -> dayOfWeek   = 1 + (n % 7);
+    date -> dayOfMonth  = 1 + (n % 31);
+    date -> month       = 1 + (n % 12);
+    date -> year        = n % 100;
+}
+
+// The example's printDateInfo before the formatter went in.
+static void _benchDateOld(benchDate* dateIn){
+    uint8_t dateStringBuffer[5] = {0,0,0,0,0};
+
+    usartStringSend(USART2, (uint8_t*)"Display:\r\n");
+
+    _benchItoa(dateIn->hour, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"Hr  = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->minute, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"Min = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->second, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"Sec = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->dayOfWeek, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"DOW = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->dayOfMonth, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"DOM = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->month, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"Mon = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+
+    _benchItoa(dateIn->year, (char*)dateStringBuffer, 10);
+    usartStringSend(USART2, (uint8_t*)"Yr  = ");
+    usartStringSend(USART2, dateStringBuffer);
+    usartStringSend(USART2, (uint8_t*)"\r\n\r\n");
+}
+
+// The example's printDateInfo as it is now.
+static void _benchDateNew(benchDate* dateIn){
+    usartPrintf(USART2,
+            "Display:\r\n"
+            "Hr  = %u\r\n"
+            "Min = %u\r\n"
+            "Sec = %u\r\n"
+            "DOW = %u\r\n"
+            "DOM = %u\r\n"
+            "Mon = %u\r\n"
+            "Yr  = %u\r\n\r\n",
+            dateIn->hour, dateIn->minute, dateIn->second, dateIn->dayOfWeek,
+            dateIn->dayOfMonth, dateIn->month, dateIn->year);
+}
+
+// One register line of the example's i2cStatePrint.
+static void _benchRegOld(uint32_t reg){
+    char regString[10];
+
+    _benchItoa(reg, regString, 16);
+    usartStringSend(USART2, (uint8_t*)"SR1 = ");
+    usartStringSend(USART2, (uint8_t*)regString);
+    usartStringSend(USART2, (uint8_t*)"\r\n");
+}
+
+static void _benchRegNew(uint32_t reg){
+    usartPrintf(USART2, "SR1 = %x\r\n", reg);
+}
+
+static void _benchReport(const char* what, double oldNs, double newNs,
+        uint32_t count){
+    printf("%-22s %9.1f ns %9.1f ns %6.2fx\n", what, oldNs / count,
+            newNs / count, oldNs / newNs);
+}
+
+//// Public Functions
+
+int main(void){
+    benchDate date;
+    char tmp[12];
+    double t0, t1, t2;
+    uint32_t n;
+
+    // Blocking sends never wait: the stand-in data register is always empty.
+    USART2 -> SR = USART_SR_TXE | USART_SR_TC;
+
+    printf("%-22s %12s %12s %7s\n", "", "itoa path", "usartPrintf",
+            "speedup");
+
+    t0 = _benchNow();
+    for(n = 0; n < BENCH_LINES; n++){
+        _benchDateGet(&date, n);
+        _benchDateOld(&date);
+    }
+    t1 = _benchNow();
+    for(n = 0; n < BENCH_LINES; n++){
+        _benchDateGet(&date, n);
+        _benchDateNew(&date);
+    }
+    t2 = _benchNow();
+    _benchReport("printDateInfo block", t1 - t0, t2 - t1, BENCH_LINES);
+
+    t0 = _benchNow();
+    for(n = 0; n < BENCH_LINES; n++) _benchRegOld(n * 0x9E3779B1u);
+    t1 = _benchNow();
+    for(n = 0; n < BENCH_LINES; n++) _benchRegNew(n * 0x9E3779B1u);
+    t2 = _benchNow();
+    _benchReport("i2cStatePrint line", t1 - t0, t2 - t1, BENCH_LINES);
+
+    t0 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchItoa(n % 100, tmp, 10);
+        _benchSink += tmp[0];
+    }
+    t1 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchSink += _usartFmtDec(tmp, n % 100) + tmp[9];
+    }
+    t2 = _benchNow();
+    _benchReport("decimal, 0-99", t1 - t0, t2 - t1, BENCH_CONVERSIONS);
+
+    t0 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchItoa(n * 2654435761u, tmp, 10);
+        _benchSink += tmp[0];
+    }
+    t1 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchSink += _usartFmtDec(tmp, n * 2654435761u) + tmp[9];
+    }
+    t2 = _benchNow();
+    _benchReport("decimal, 32-bit", t1 - t0, t2 - t1, BENCH_CONVERSIONS);
+
+    t0 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchItoa(n * 2654435761u, tmp, 16);
+        _benchSink += tmp[0];
+    }
+    t1 = _benchNow();
+    for(n = 0; n < BENCH_CONVERSIONS; n++){
+        _benchSink += _usartFmtHex(tmp, n * 2654435761u, _usartHexLower)
+            + tmp[9];
+    }
+    t2 = _benchNow();
+    _benchReport("hex, 32-bit", t1 - t0, t2 - t1, BENCH_CONVERSIONS);
+
+    return 0;
+}